@@ -43,7 +43,11 @@ AVCodec* AMTSource::getHWAccelCodec(AVCodecID vcodecId) {
 }
 
 void AMTSource::MakeCodecContext(IScriptEnvironment* env) {
-    AVCodecID vcodecId = videoStream->codecpar->codec_id;
+    OpenDecoder(codecCtx, videoStream, (decodeThreads) ? decodeThreads : GetProcessorCount(), env);
+}
+
+void AMTSource::OpenDecoder(CodecContext& codec, AVStream* stream, int threads, IScriptEnvironment* env) {
+    AVCodecID vcodecId = stream->codecpar->codec_id;
     AVCodec *pCodec = getHWAccelCodec(vcodecId);
     if (pCodec == NULL) {
         ctx.warn("指定されたデコーダが使用できないためデフォルトデコーダを使います");
@@ -52,18 +56,18 @@ void AMTSource::MakeCodecContext(IScriptEnvironment* env) {
     if (pCodec == NULL) {
         env->ThrowError("Could not find decoder ...");
     }
-    codecCtx.Set(pCodec);
-    if (avcodec_parameters_to_context(codecCtx(), videoStream->codecpar) != 0) {
+    codec.Set(pCodec);
+    if (avcodec_parameters_to_context(codec(), stream->codecpar) != 0) {
         env->ThrowError("avcodec_parameters_to_context failed");
     }
-    codecCtx()->pkt_timebase = videoStream->time_base;
-    codecCtx()->thread_count = GetFFmpegThreads((decodeThreads) ? decodeThreads : GetProcessorCount());
+    codec()->pkt_timebase = stream->time_base;
+    codec()->thread_count = GetFFmpegThreads(threads);
 
     // export_mvs for codecview
     //AVDictionary *opts = NULL;
     //av_dict_set(&opts, "flags2", "+export_mvs", 0);
 
-    if (avcodec_open2(codecCtx(), pCodec, NULL) != 0) {
+    if (avcodec_open2(codec(), pCodec, NULL) != 0) {
         env->ThrowError("avcodec_open2 failed");
     }
 }
@@ -260,18 +264,35 @@ PVideoFrame AMTSource::MakeFrame(AVFrame* top, AVFrame* bottom, IScriptEnvironme
 }
 
 void AMTSource::PutFrame(int n, const PVideoFrame& frame) {
+    auto it = frameCache.find(n);
+    if (it != frameCache.end()) {
+        UnlinkFrame(it->second.get());
+        cacheBytes -= it->second->bytes;
+        frameCache.erase(it);
+    }
+
     CacheFrame* pcache = new CacheFrame();
     pcache->data = frame;
     pcache->key = n;
-    frameCache[n] = pcache;
-    recentAccessed.push_front(pcache);
-
-    if ((int)recentAccessed.size() > seekDistance * 3 / 2) {
-        // キャッシュから溢れたら削除
-        CacheFrame* pdel = recentAccessed.back();
+    pcache->bytes = frame->GetPitch(PLANAR_Y) * frame->GetHeight(PLANAR_Y) +
+        frame->GetPitch(PLANAR_U) * frame->GetHeight(PLANAR_U) +
+        frame->GetPitch(PLANAR_V) * frame->GetHeight(PLANAR_V);
+    pcache->newer = nullptr;
+    pcache->older = nullptr;
+    frameCache[n] = std::unique_ptr<CacheFrame>(pcache);
+    UpdateAccessed(pcache);
+    cacheBytes += pcache->bytes;
+    maxFrameBytes = std::max(maxFrameBytes, pcache->bytes);
+    peakCacheBytes = std::max(peakCacheBytes, cacheBytes);
+
+    size_t limitBytes = GetCacheLimitBytes();
+    while (cacheBytes > limitBytes && oldestFrame != newestFrame) {
+        // キャッシュから溢れたら最も古くアクセスしたものから削除
+        CacheFrame* pdel = oldestFrame;
+        UnlinkFrame(pdel);
+        cacheBytes -= pdel->bytes;
         frameCache.erase(pdel->key);
-        recentAccessed.pop_back();
-        delete pdel;
+        ++numCacheEvictions;
     }
 }
 
@@ -325,10 +346,10 @@ void AMTSource::OnFrameDecoded(Frame& frame, IScriptEnvironment* env) {
 }
 #endif
 
-void AMTSource::OnFrameOutput(Frame& frame, IScriptEnvironment* env) {
+int AMTSource::PTSToFrameIndex(int64_t framePTS) const {
     // ffmpegのpts wrapの仕方が謎なので下位33bitのみを見る
     //（26時間以上ある動画だと重複する可能性はあるが無視）
-    int64_t pts = frame()->pts & ((int64_t(1) << 33) - 1);
+    int64_t pts = framePTS & ((int64_t(1) << 33) - 1);
 
     int64_t headDiff = 0, tailDiff = 0;
     auto it = std::lower_bound(frames.begin(), frames.end(), pts, [](const FilterSourceFrame& e, int64_t pts) {
@@ -349,28 +370,42 @@ void AMTSource::OnFrameOutput(Frame& frame, IScriptEnvironment* env) {
         tailDiff = pts - frames.back().framePTS;
         // 前の可能性もあるので、判定
         if (headDiff == 0 || headDiff > tailDiff) {
-            lastDecodeFrame = vi.num_frames;
+            return vi.num_frames;
         }
-        prevFrame = nullptr; // 連続でなくなる場合はnullリセット
-        return;
+        return PTS_BEFORE;
     }
 
     if (it->framePTS != pts) {
-        // 一致するフレームがない
-        ctx.incrementCounter(AMT_ERR_UNKNOWN_PTS);
-        ctx.warnF("Unknown PTS frame %lld", pts);
+        return PTS_UNKNOWN;
+    }
+
+    return int(it - frames.begin());
+}
+
+void AMTSource::OnFrameOutput(Frame& frame, IScriptEnvironment* env) {
+    int frameIndex = PTSToFrameIndex(frame()->pts);
+
+    if (frameIndex < 0 || frameIndex >= vi.num_frames) {
+        if (frameIndex == vi.num_frames) {
+            // 最後より後ろだった
+            lastDecodeFrame = vi.num_frames;
+        } else if (frameIndex == PTS_UNKNOWN) {
+            // 一致するフレームがない
+            ctx.incrementCounter(AMT_ERR_UNKNOWN_PTS);
+            ctx.warnF("Unknown PTS frame %lld", frame()->pts & ((int64_t(1) << 33) - 1));
+        }
         prevFrame = nullptr; // 連続でなくなる場合はnullリセット
         return;
     }
 
-    int frameIndex = int(it - frames.begin());
+    auto it = frames.begin() + frameIndex;
     auto cacheit = frameCache.find(frameIndex);
 
     if (it->halfDelay) {
         // ディレイを適用させる
         if (cacheit != frameCache.end()) {
             // すでにキャッシュにある
-            UpdateAccessed(cacheit->second);
+            UpdateAccessed(cacheit->second.get());
             lastDecodeFrame = frameIndex;
         } else if (prevFrame != nullptr) {
             PutFrame(frameIndex, MakeFrame((*prevFrame)(), frame(), env));
@@ -385,7 +420,7 @@ void AMTSource::OnFrameOutput(Frame& frame, IScriptEnvironment* env) {
             auto cachenext = frameCache.find(frameIndex + 1);
             if (cachenext != frameCache.end()) {
                 // すでにキャッシュにある
-                UpdateAccessed(cachenext->second);
+                UpdateAccessed(cachenext->second.get());
             } else {
                 PutFrame(frameIndex + 1, MakeFrame(frame(), frame(), env));
             }
@@ -395,7 +430,7 @@ void AMTSource::OnFrameOutput(Frame& frame, IScriptEnvironment* env) {
         // そのまま
         if (cacheit != frameCache.end()) {
             // すでにキャッシュにある
-            UpdateAccessed(cacheit->second);
+            UpdateAccessed(cacheit->second.get());
         } else {
             PutFrame(frameIndex, MakeFrame(frame(), frame(), env));
         }
@@ -406,24 +441,63 @@ void AMTSource::OnFrameOutput(Frame& frame, IScriptEnvironment* env) {
 }
 
 void AMTSource::UpdateAccessed(CacheFrame* frame) {
-    // recentAccessed にframeがあれば先頭に移動
-    auto target = std::find(recentAccessed.begin(), recentAccessed.end(), frame);
-    if (target != recentAccessed.end()) {
-        recentAccessed.erase(target);
+    // リストの先頭に移動
+    if (frame == newestFrame) {
+        return;
+    }
+    UnlinkFrame(frame);
+    frame->older = newestFrame;
+    if (newestFrame != nullptr) {
+        newestFrame->newer = frame;
+    }
+    newestFrame = frame;
+    if (oldestFrame == nullptr) {
+        oldestFrame = frame;
+    }
+}
+
+void AMTSource::UnlinkFrame(CacheFrame* frame) {
+    if (frame->newer != nullptr) {
+        frame->newer->older = frame->older;
+    } else if (newestFrame == frame) {
+        newestFrame = frame->older;
+    }
+    if (frame->older != nullptr) {
+        frame->older->newer = frame->newer;
+    } else if (oldestFrame == frame) {
+        oldestFrame = frame->newer;
     }
-    recentAccessed.push_front(frame);
+    frame->newer = frame->older = nullptr;
+}
+
+size_t AMTSource::GetCacheLimitBytes() const {
+    // 時間方向フィルタの要求範囲が入らないと毎フレームデコードし直しになるので
+    // 上限が小さすぎてもそれだけは保持する
+    return std::max(cacheLimitBytes, maxFrameBytes * cacheWindow);
 }
 
 PVideoFrame AMTSource::ForceGetFrame(int n, IScriptEnvironment* env) {
     if (frameCache.size() == 0) {
         return env->NewVideoFrame(vi);
     }
-    auto lb = frameCache.lower_bound(n);
-    if (lb->first != n && lb != frameCache.begin()) {
-        lb--;
+    auto it = frameCache.find(n);
+    if (it == frameCache.end()) {
+        // ない場合はn以前で最も近いフレーム（なければn以降で最も近いフレーム）
+        // デコード失敗時しか来ないので線形探索でよい
+        CacheFrame* before = nullptr;
+        CacheFrame* after = nullptr;
+        for (auto& entry : frameCache) {
+            CacheFrame* frame = entry.second.get();
+            if (frame->key < n) {
+                if (before == nullptr || before->key < frame->key) before = frame;
+            } else {
+                if (after == nullptr || after->key > frame->key) after = frame;
+            }
+        }
+        it = frameCache.find((before != nullptr) ? before->key : after->key);
     }
-    UpdateAccessed(lb->second);
-    return lb->second->data;
+    UpdateAccessed(it->second.get());
+    return it->second->data;
 }
 
 void AMTSource::DecodeLoop(int goal, IScriptEnvironment* env) {
@@ -444,16 +518,6 @@ void AMTSource::DecodeLoop(int goal, IScriptEnvironment* env) {
     // packetからキーフレームのPTSを取得して
     // デコードしたフレームがそのPTSならキーフレームと判断する
     int64_t keyFramePTS = -1;
-    auto isFrameReady = [&]() {
-        // シーク後最初のフレームでないならOK
-        if (lastDecodeFrame != -1) return true;
-        // キーフレームならOK
-        if (frame()->key_frame) return true;
-        // タイムスタンプがキーフレームのものならキーフレームと判断
-        if (keyFramePTS != -1 && keyFramePTS == frame()->pts) return true;
-        // まだキーフレームでないので、欠損を含む可能性がある
-        return false;
-        };
 
     while (av_read_frame(inputCtx(), &packet) == 0) {
         if (packet.stream_index == videoStream->index) {
@@ -466,14 +530,7 @@ void AMTSource::DecodeLoop(int goal, IScriptEnvironment* env) {
                 ctx.warn("avcodec_send_packet failed");
             }
             while (avcodec_receive_frame(codecCtx(), frame()) == 0) {
-                // 最初はキーフレームまでスキップ
-                if (isFrameReady()) {
-#if ENABLE_FFMPEG_FILTER
-                    OnFrameDecoded(frame, env);
-#else
-                    OnFrameOutput(frame, env);
-#endif
-                }
+                OnFrameReceived(frame, keyFramePTS, env);
             }
         }
         av_packet_unref(&packet);
@@ -481,6 +538,46 @@ void AMTSource::DecodeLoop(int goal, IScriptEnvironment* env) {
             return;
         }
     }
+    OnStreamEnd(env);
+}
+
+void AMTSource::DecodeLoopAhead(int goal, IScriptEnvironment* env) {
+    if (!aheadThread->isActive()) {
+        // デコーダの状態はここまでの同期デコードの続きになる
+        aheadThread->resume();
+    }
+    DecodedFrame decoded;
+    while (aheadThread->get(decoded)) {
+        OnFrameReceived(decoded.frame, decoded.keyFramePTS, env);
+        if (lastDecodeFrame >= goal) {
+            return;
+        }
+    }
+    OnStreamEnd(env);
+}
+
+void AMTSource::OnFrameReceived(Frame& frame, int64_t keyFramePTS, IScriptEnvironment* env) {
+    auto isFrameReady = [&]() {
+        // シーク後最初のフレームでないならOK
+        if (lastDecodeFrame != -1) return true;
+        // キーフレームならOK
+        if (frame()->key_frame) return true;
+        // タイムスタンプがキーフレームのものならキーフレームと判断
+        if (keyFramePTS != -1 && keyFramePTS == frame()->pts) return true;
+        // まだキーフレームでないので、欠損を含む可能性がある
+        return false;
+        };
+    // 最初はキーフレームまでスキップ
+    if (isFrameReady()) {
+#if ENABLE_FFMPEG_FILTER
+        OnFrameDecoded(frame, env);
+#else
+        OnFrameOutput(frame, env);
+#endif
+    }
+}
+
+void AMTSource::OnStreamEnd(IScriptEnvironment* env) {
 #if ENABLE_FFMPEG_FILTER
     if (bufferSrcCtx) {
         // ストリームは全て読み取ったのでフィルタをflush
@@ -489,10 +586,378 @@ void AMTSource::DecodeLoop(int goal, IScriptEnvironment* env) {
 #endif
 }
 
+AMTSource::DecodeAheadThread::DecodeAheadThread(AMTSource& this_, int maxFrames)
+    : this_(this_)
+    , maxFrames(maxFrames)
+    , keyFramePTS(-1)
+    , active(false)
+    , busy(false)
+    , eof(false)
+    , canceled(false) {
+    start();
+}
+
+AMTSource::DecodeAheadThread::~DecodeAheadThread() {
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        canceled = true;
+        cond.notify_all();
+    }
+    join();
+}
+
+bool AMTSource::DecodeAheadThread::isActive() const {
+    return active;
+}
+
+void AMTSource::DecodeAheadThread::resume() {
+    std::unique_lock<std::mutex> lock(mtx);
+    queue.clear();
+    keyFramePTS = -1;
+    eof = false;
+    active = true;
+    cond.notify_all();
+}
+
+void AMTSource::DecodeAheadThread::pause() {
+    std::unique_lock<std::mutex> lock(mtx);
+    active = false;
+    // デコード中のパケットが終わるのを待つ
+    while (busy) {
+        cond.wait(lock);
+    }
+    queue.clear();
+}
+
+bool AMTSource::DecodeAheadThread::get(DecodedFrame& frame) {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (queue.empty() && !eof) {
+        cond.wait(lock);
+    }
+    if (queue.empty()) {
+        return false;
+    }
+    frame = queue.front();
+    queue.pop_front();
+    cond.notify_all();
+    return true;
+}
+
+/* virtual */ void AMTSource::DecodeAheadThread::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            while (!canceled && !(active && !eof && (int)queue.size() < maxFrames)) {
+                cond.wait(lock);
+            }
+            if (canceled) return;
+            busy = true;
+        }
+        decodePacket();
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            busy = false;
+            cond.notify_all();
+        }
+    }
+}
+
+void AMTSource::DecodeAheadThread::decodePacket() {
+    AVPacket packet = AVPacket();
+    if (av_read_frame(this_.inputCtx(), &packet) != 0) {
+        std::unique_lock<std::mutex> lock(mtx);
+        eof = true;
+        return;
+    }
+    if (packet.stream_index == this_.videoStream->index) {
+        if ((packet.flags & AV_PKT_FLAG_KEY) && keyFramePTS == -1) {
+            // 最初のキーフレームのPTSを覚えておく
+            keyFramePTS = packet.pts;
+        }
+        if (avcodec_send_packet(this_.codecCtx(), &packet) != 0) {
+            this_.ctx.incrementCounter(AMT_ERR_DECODE_PACKET_FAILED);
+            this_.ctx.warn("avcodec_send_packet failed");
+        }
+        DecodedFrame decoded;
+        while (avcodec_receive_frame(this_.codecCtx(), decoded.frame()) == 0) {
+            decoded.keyFramePTS = keyFramePTS;
+            std::unique_lock<std::mutex> lock(mtx);
+            queue.push_back(decoded);
+            cond.notify_all();
+        }
+    }
+    av_packet_unref(&packet);
+}
+
+AMTSource::SegmentDecoder::SegmentDecoder(AMTSource& this_, const tstring& srcpath, int numDecoders, IScriptEnvironment* env)
+    : this_(this_)
+    , nextSegment(0)
+    , finished(false) {
+    // 最低これだけのフレーム数になるようにGOPをまとめて区間にする
+    // 区間の最後で次のGOPの先頭まではデコードするのでその分が無駄になる
+    enum { MIN_SEGMENT_FRAMES = 30 };
+    const auto& frames = this_.frames;
+    for (int i = 0; i < (int)frames.size(); ++i) {
+        if (frames[i].keyFrame != i) continue;
+        if (segmentStarts.empty() || i - segmentStarts.back() >= MIN_SEGMENT_FRAMES) {
+            segmentStarts.push_back(i);
+        }
+    }
+    if (segmentStarts.empty() || segmentStarts[0] != 0) {
+        segmentStarts.insert(segmentStarts.begin(), 0);
+    }
+    // 1デコーダのスレッド数は全体を分け合う
+    int totalThreads = (this_.decodeThreads) ? this_.decodeThreads : GetProcessorCount();
+    int threads = std::max(1, totalThreads / numDecoders);
+    try {
+        for (int i = 0; i < numDecoders; ++i) {
+            workers.emplace_back(new Worker(*this, srcpath, threads, env));
+        }
+    } catch (...) {
+        // 起動済みのワーカーを止める
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            finished = true;
+            cond.notify_all();
+        }
+        workers.clear();
+        throw;
+    }
+}
+
+AMTSource::SegmentDecoder::~SegmentDecoder() {
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        clearWindow();
+        finished = true;
+        cond.notify_all();
+    }
+    workers.clear();
+}
+
+bool AMTSource::SegmentDecoder::isInWindow(int n) {
+    std::unique_lock<std::mutex> lock(mtx);
+    int segIdx = findSegment(n);
+    return window.size() > 0 &&
+        window.front()->index <= segIdx && segIdx <= window.back()->index;
+}
+
+bool AMTSource::SegmentDecoder::get(int n, Frame& top, Frame& bottom) {
+    std::unique_lock<std::mutex> lock(mtx);
+    int segIdx = findSegment(n);
+    // 通り過ぎた区間は捨てる
+    while (window.size() > 0 && window.front()->index < segIdx) {
+        window.front()->canceled = true;
+        window.pop_front();
+    }
+    if (window.empty() || window.front()->index != segIdx) {
+        // 後ろに戻ったかデコード中の範囲より先に飛んだ
+        clearWindow();
+        nextSegment = segIdx;
+    }
+    fillWindow();
+    SegmentPtr seg = window.front();
+    while (!seg->done) {
+        cond.wait(lock);
+    }
+    if (seg->frames[0].valid) {
+        // 通常のデコードと同じくシークで分かったことをシークインデックスに反映する
+        this_.updateSeekIndex(seg->begin, seg->seekFrame);
+    }
+    const SegmentFrame& frame = seg->frames[n - seg->begin];
+    if (!frame.valid) {
+        return false;
+    }
+    top = frame.top;
+    bottom = frame.bottom;
+    return true;
+}
+
+int AMTSource::SegmentDecoder::findSegment(int n) const {
+    return int(std::upper_bound(segmentStarts.begin(), segmentStarts.end(), n) - segmentStarts.begin()) - 1;
+}
+
+// デコーダ数+1区間まで先にデコードを始めておく
+void AMTSource::SegmentDecoder::fillWindow() {
+    while ((int)window.size() < (int)workers.size() + 1 && nextSegment < (int)segmentStarts.size()) {
+        SegmentPtr seg = SegmentPtr(new Segment());
+        seg->index = nextSegment;
+        seg->begin = segmentStarts[nextSegment];
+        seg->end = (nextSegment + 1 < (int)segmentStarts.size())
+            ? segmentStarts[nextSegment + 1] : (int)this_.frames.size();
+        // シークインデックスはGetFrameでしか更新されないのでここで読んでおく
+        seg->seekFrame = this_.seekIndex.seekFrames[seg->begin];
+        seg->frames.resize(seg->end - seg->begin);
+        for (auto& frame : seg->frames) {
+            frame.valid = false;
+        }
+        seg->done = false;
+        seg->canceled = false;
+        window.push_back(seg);
+        pending.push_back(seg);
+        ++nextSegment;
+    }
+    cond.notify_all();
+}
+
+void AMTSource::SegmentDecoder::clearWindow() {
+    for (auto& seg : window) {
+        seg->canceled = true;
+    }
+    window.clear();
+    pending.clear();
+}
+
+AMTSource::SegmentDecoder::Worker::Worker(SegmentDecoder& parent, const tstring& srcpath, int threads, IScriptEnvironment* env)
+    : parent(parent)
+    , this_(parent.this_)
+    , inputCtx(srcpath) {
+    if (avformat_find_stream_info(inputCtx(), NULL) < 0) {
+        env->ThrowError("avformat_find_stream_info failed");
+    }
+    videoStream = GetVideoStream(inputCtx());
+    if (videoStream == NULL) {
+        env->ThrowError("Could not find video stream ...");
+    }
+    this_.OpenDecoder(codecCtx, videoStream, threads, env);
+    start();
+}
+
+AMTSource::SegmentDecoder::Worker::~Worker() {
+    join();
+}
+
+/* virtual */ void AMTSource::SegmentDecoder::Worker::run() {
+    while (true) {
+        SegmentPtr seg;
+        {
+            std::unique_lock<std::mutex> lock(parent.mtx);
+            while (parent.pending.empty() && !parent.finished) {
+                parent.cond.wait(lock);
+            }
+            if (parent.finished) return;
+            seg = parent.pending.front();
+            parent.pending.pop_front();
+        }
+        decodeSegment(*seg);
+        {
+            std::unique_lock<std::mutex> lock(parent.mtx);
+            seg->done = true;
+            parent.cond.notify_all();
+        }
+    }
+}
+
+// AMTSource::GetFrameのシークと同じ手順で区間の先頭に到達できるまでシーク位置を戻して試す
+// 到達できなかった場合の失敗フレームの登録は通常のデコードに任せる
+void AMTSource::SegmentDecoder::Worker::decodeSegment(Segment& seg) {
+    const auto& frames = this_.frames;
+    int keyNum = seg.seekFrame;
+    for (int i = 0; ; ++i) {
+        int lastDecodeFrame = -1;
+        if (!decodeFrom(seg, keyNum, lastDecodeFrame) || seg.canceled) {
+            return;
+        }
+        if (seg.frames[0].valid) {
+            // デコード成功
+            seg.seekFrame = keyNum;
+            break;
+        }
+        if (keyNum <= 0 || (lastDecodeFrame >= 0 && lastDecodeFrame < seg.begin) || i == 2) {
+            // これ以上戻れないか、データが足りないか、デコード失敗
+            break;
+        }
+        keyNum = this_.getRetrySeekFrame(keyNum);
+    }
+
+    // 同じPTSのフレームが続く場合はデコードでは出てこないので前のフレームで埋める
+    //（AMTSource::ForceGetFrameと同じ）
+    for (int i = seg.begin + 1; i < seg.end; ++i) {
+        SegmentFrame& cur = seg.frames[i - seg.begin];
+        const SegmentFrame& prev = seg.frames[i - 1 - seg.begin];
+        if (!cur.valid && prev.valid && frames[i].framePTS == frames[i - 1].framePTS) {
+            cur.top = prev.top;
+            cur.bottom = prev.bottom;
+            cur.valid = true;
+        }
+    }
+}
+
+bool AMTSource::SegmentDecoder::Worker::decodeFrom(Segment& seg, int keyNum, int& lastDecodeFrame) {
+    const auto& frames = this_.frames;
+    int numFrames = (int)frames.size();
+    int64_t fileOffset = frames[keyNum].fileOffset / 188 * 188;
+    if (av_seek_frame(inputCtx(), -1, fileOffset, AVSEEK_FLAG_BYTE) < 0) {
+        return false;
+    }
+    avcodec_flush_buffers(codecCtx());
+
+    auto setFrame = [&](int index, const Frame& top, const Frame& bottom) {
+        if (index >= seg.begin && index < seg.end) {
+            SegmentFrame& dst = seg.frames[index - seg.begin];
+            dst.top = top;
+            dst.bottom = bottom;
+            dst.valid = true;
+        }
+    };
+
+    // 以下はAMTSource::DecodeLoopとOnFrameOutputと同じ処理
+    Frame frame;
+    Frame prevFrame;
+    bool hasPrevFrame = false;
+    lastDecodeFrame = -1;
+    int64_t keyFramePTS = -1;
+    AVPacket packet = AVPacket();
+    while (lastDecodeFrame < seg.end - 1 && !seg.canceled && av_read_frame(inputCtx(), &packet) == 0) {
+        if (packet.stream_index == videoStream->index) {
+            if ((packet.flags & AV_PKT_FLAG_KEY) && keyFramePTS == -1) {
+                keyFramePTS = packet.pts;
+            }
+            // エラーはここでは無視する（出てこなかったフレームは通常のデコードで処理される）
+            avcodec_send_packet(codecCtx(), &packet);
+            while (avcodec_receive_frame(codecCtx(), frame()) == 0) {
+                // シーク後最初はキーフレームまでスキップ
+                if (lastDecodeFrame == -1 && !frame()->key_frame &&
+                    !(keyFramePTS != -1 && keyFramePTS == frame()->pts)) {
+                    continue;
+                }
+                int frameIndex = this_.PTSToFrameIndex(frame()->pts);
+                if (frameIndex < 0 || frameIndex >= numFrames) {
+                    if (frameIndex == numFrames) {
+                        lastDecodeFrame = numFrames;
+                    }
+                    hasPrevFrame = false;
+                    continue;
+                }
+                if (frames[frameIndex].halfDelay) {
+                    // ディレイを適用させる
+                    if (hasPrevFrame) {
+                        setFrame(frameIndex, prevFrame, frame);
+                        lastDecodeFrame = frameIndex;
+                    }
+                    // 次のフレームも同じフレームを参照してたらそれも出力
+                    if (frameIndex + 1 < numFrames && frames[frameIndex + 1].framePTS == frames[frameIndex].framePTS) {
+                        setFrame(frameIndex + 1, frame, frame);
+                        lastDecodeFrame = frameIndex + 1;
+                    }
+                } else {
+                    setFrame(frameIndex, frame, frame);
+                    lastDecodeFrame = frameIndex;
+                }
+                prevFrame = frame;
+                hasPrevFrame = true;
+            }
+        }
+        av_packet_unref(&packet);
+    }
+    return true;
+}
+
 void AMTSource::registerFailedFrames(int begin, int end, int replace, IScriptEnvironment* env) {
     for (int f = begin; f < end; ++f) {
         failedMap[f] = replace;
     }
+    seekIndexUpdated = true;
     // デコード不可フレーム数が１割を超える場合はエラーとする
     if (failedMap.size() * 10 > frames.size()) {
         env->ThrowError("[AMTSource] デコードできないフレーム数が多すぎます -> %dフレームがデコード不可",
@@ -500,6 +965,26 @@ void AMTSource::registerFailedFrames(int begin, int end, int replace, IScriptEnv
     }
 }
 
+int AMTSource::getRetrySeekFrame(int keyNum) const {
+    // 1つ前のGOPの先頭（最低でも5フレーム）まで戻る
+    return keyNum - std::max(5, keyNum - frames[keyNum - 1].keyFrame);
+}
+
+void AMTSource::updateSeekIndex(int n, int keyNum) {
+    if (n - keyNum > seekDistance) {
+        seekDistance = n - keyNum;
+        seekIndexUpdated = true;
+    }
+    if (keyNum < seekIndex.seekFrames[n]) {
+        // キーフレームより前から始める必要があった
+        // GOPの残りのフレームも同じ位置から始めるようにする
+        for (int f = n; f < (int)frames.size() && frames[f].keyFrame == frames[n].keyFrame; ++f) {
+            seekIndex.seekFrames[f] = std::min(seekIndex.seekFrames[f], keyNum);
+        }
+        seekIndexUpdated = true;
+    }
+}
+
 AMTSource::AMTSource(AMTContext& ctx,
     const tstring& srcpath,
     const tstring& audiopath,
@@ -510,22 +995,39 @@ AMTSource::AMTSource(AMTContext& ctx,
     const int threads,
     const char* filterdesc,
     bool outputQP,
+    int decodeAhead,
+    int numDecoders,
+    int cacheMB,
     IScriptEnvironment* env)
     : AMTObject(ctx)
     , frames(frames)
-    , decoderSetting(decoderSetting)
-    , decodeThreads(threads)
     , audioFrames(audioFrames)
+    , decoderSetting(decoderSetting)
     , filterdesc(filterdesc)
+    , decodeThreads(threads)
+    , decodeAhead(decodeAhead)
+    , numDecoders(numDecoders)
     , outputQP(outputQP)
     , inputCtx(srcpath)
-    , vi()
-    , waveFile(audiopath, _T("rb"))
 #if ENABLE_FFMPEG_FILTER
     , bufferSrcCtx()
     , bufferSinkCtx()
 #endif
+    , newestFrame(nullptr)
+    , oldestFrame(nullptr)
+    , cacheBytes(0)
+    , maxFrameBytes(0)
+    , cacheWindow(0)
+    , cacheLimitBytes((size_t)std::max(1, cacheMB) * 1024 * 1024)
+    , peakCacheBytes(0)
+    , numCacheHits(0)
+    , numCacheMisses(0)
+    , numCacheEvictions(0)
+    , lastRequestFrame(-1)
+    , vi()
+    , waveSource(OpenWaveSource(ctx, audiopath))
     , seekDistance(10)
+    , seekIndexUpdated(false)
     , lastDecodeFrame(-1) {
 #if !ENABLE_FFMPEG_FILTER
     if (this->filterdesc.size()) {
@@ -534,6 +1036,10 @@ AMTSource::AMTSource(AMTContext& ctx,
 #endif
     MakeVideoInfo(vfmt, afmt);
 
+    // インデックスがなくてもキーフレームからシークできるようにしておく
+    seekIndex.init(frames);
+    seekDistance = seekIndex.seekDistance;
+
     if (avformat_find_stream_info(inputCtx(), NULL) < 0) {
         env->ThrowError("avformat_find_stream_info failed");
     }
@@ -545,31 +1051,76 @@ AMTSource::AMTSource(AMTContext& ctx,
     // 初期化
     ResetDecoder(env);
     UpdateVideoInfo(env);
+
+    if (numDecoders > 1 && this->filterdesc.empty()) {
+        // FFmpegフィルタはデコーダ毎に状態を持つので並列デコードできない
+        segmentDecoder = std::unique_ptr<SegmentDecoder>(new SegmentDecoder(*this, srcpath, numDecoders, env));
+    } else if (decodeAhead > 0) {
+        aheadThread = std::unique_ptr<DecodeAheadThread>(new DecodeAheadThread(*this, decodeAhead));
+    }
 }
 
+// シークインデックスの書き戻し用
+static std::mutex g_seekIndexMutex;
+
 AMTSource::~AMTSource() {
-    // キャッシュを削除
-    while (recentAccessed.size() > 0) {
-        CacheFrame* pdel = recentAccessed.back();
-        frameCache.erase(pdel->key);
-        recentAccessed.pop_back();
-        delete pdel;
+    // デコーダより先に先読みスレッドを止める
+    segmentDecoder = nullptr;
+    aheadThread = nullptr;
+    if (seekIndexUpdated && seekIndexPath.size() > 0) {
+        // シークで分かったことを書き戻して他のインスタンスで使えるようにする
+        try {
+            seekIndex.seekDistance = seekDistance;
+            seekIndex.failedFrames.assign(failedMap.begin(), failedMap.end());
+            // 同じプロセスの他のインスタンスと読み込み～書き戻しが交差しないようにする
+            std::lock_guard<std::mutex> lock(g_seekIndexMutex);
+            AMTSeekIndex saved;
+            if (LoadAMTSeekIndex(seekIndexPath, (int)frames.size(), saved)) {
+                seekIndex.merge(saved);
+            }
+            SaveAMTSeekIndex(seekIndexPath, seekIndex);
+        } catch (const Exception& e) {
+            ctx.warnF("シークインデックスを保存できませんでした: %s", e.message());
+        }
     }
+    ctx.infoF("AMTSource フレームキャッシュ ヒット: %lld ミス: %lld 追い出し: %lld 最大使用量: %.1fMB/%.1fMB",
+        numCacheHits, numCacheMisses, numCacheEvictions,
+        peakCacheBytes / (1024.0 * 1024.0), GetCacheLimitBytes() / (1024.0 * 1024.0));
+    // キャッシュを削除
+    newestFrame = oldestFrame = nullptr;
+    frameCache.clear();
 }
 
 void AMTSource::TransferStreamInfo(std::unique_ptr<AMTSourceData>&& streamInfo) {
     storage = std::move(streamInfo);
 }
 
+void AMTSource::SetSeekIndex(const tstring& path) {
+    seekIndexPath = path;
+    AMTSeekIndex loaded;
+    if (LoadAMTSeekIndex(path, (int)frames.size(), loaded)) {
+        seekIndex = loaded;
+        seekDistance = std::max(seekDistance, loaded.seekDistance);
+        for (const auto& failed : loaded.failedFrames) {
+            failedMap[failed.first] = failed.second;
+        }
+    }
+}
+
 PVideoFrame __stdcall AMTSource::GetFrame(int n, IScriptEnvironment* env) {
     std::lock_guard<std::mutex> guard(mutex);
 
+    bool sequential = (n == lastRequestFrame + 1);
+    lastRequestFrame = n;
+
     // キャッシュにあれば返す
     auto it = frameCache.find(n);
     if (it != frameCache.end()) {
-        UpdateAccessed(it->second);
+        ++numCacheHits;
+        UpdateAccessed(it->second.get());
         return it->second->data;
     }
+    ++numCacheMisses;
 
     // デコードできないフレームは置換フレームに置き換える
     if (failedMap.find(n) != failedMap.end()) {
@@ -577,12 +1128,29 @@ PVideoFrame __stdcall AMTSource::GetFrame(int n, IScriptEnvironment* env) {
     }
 
     // キャッシュにないのでデコードする
+    if (segmentDecoder && (sequential || segmentDecoder->isInWindow(n))) {
+        // 連続アクセスは並列デコードした区間から取る
+        Frame top, bottom;
+        if (segmentDecoder->get(n, top, bottom)) {
+            PutFrame(n, MakeFrame(top(), bottom(), env));
+            return ForceGetFrame(n, env);
+        }
+        // デコードできなかったフレームは通常のデコードで処理する
+    }
     if (lastDecodeFrame != -1 && n > lastDecodeFrame && n < lastDecodeFrame + seekDistance) {
         // 前にすすめる
-        DecodeLoop(n, env);
+        if (aheadThread) {
+            // 連続アクセスなので先読みしながらデコード
+            DecodeLoopAhead(n, env);
+        } else {
+            DecodeLoop(n, env);
+        }
     } else {
         // シークしてデコードする
-        int keyNum = frames[n].keyFrame;
+        if (aheadThread) {
+            aheadThread->pause();
+        }
+        int keyNum = seekIndex.seekFrames[n];
         for (int i = 0; ; ++i) {
             int64_t fileOffset = frames[keyNum].fileOffset / 188 * 188;
             if (av_seek_frame(inputCtx(), -1, fileOffset, AVSEEK_FLAG_BYTE) < 0) {
@@ -592,7 +1160,7 @@ PVideoFrame __stdcall AMTSource::GetFrame(int n, IScriptEnvironment* env) {
             DecodeLoop(n, env);
             if (frameCache.find(n) != frameCache.end()) {
                 // デコード成功
-                seekDistance = std::max(seekDistance, n - keyNum);
+                updateSeekIndex(n, keyNum);
                 break;
             }
             if (keyNum <= 0) {
@@ -613,7 +1181,7 @@ PVideoFrame __stdcall AMTSource::GetFrame(int n, IScriptEnvironment* env) {
                 registerFailedFrames(n, lastDecodeFrame, lastDecodeFrame, env);
                 break;
             }
-            keyNum -= std::max(5, keyNum - frames[keyNum - 1].keyFrame);
+            keyNum = getRetrySeekFrame(keyNum);
         }
     }
 
@@ -638,8 +1206,7 @@ void __stdcall AMTSource::GetAudio(void* buf, __int64 start, __int64 count, IScr
 
         if (audioFrames[(size_t)frameIndex].waveLength != 0) {
             // waveがあるなら読む
-            waveFile.seek(audioFrames[(size_t)frameIndex].waveOffset + frameOffset * sampleBytes, SEEK_SET);
-            waveFile.read(MemoryChunk(ptr, readBytes));
+            waveSource->read(audioFrames[(size_t)frameIndex].waveOffset + frameOffset * sampleBytes, MemoryChunk(ptr, readBytes));
         } else {
             // ない場合はゼロ埋めする
             memset(ptr, 0x00, readBytes);
@@ -663,6 +1230,11 @@ bool __stdcall AMTSource::GetParity(int n) {
 int __stdcall AMTSource::SetCacheHints(int cachehints, int frame_range) {
     // 直接インスタンス化される場合、MTGuardが入らないのでMT_NICE_FILTER以外ダメ
     if (cachehints == CACHE_GET_MTMODE) return MT_NICE_FILTER;
+    if (cachehints == CACHE_WINDOW) {
+        // 時間方向フィルタが要求する範囲はキャッシュに保持する
+        std::lock_guard<std::mutex> guard(mutex);
+        cacheWindow = std::max(cacheWindow, frame_range);
+    }
     return 0;
 };
 
@@ -675,7 +1247,8 @@ void SaveAMTSource(
     const VideoFormat& vfmt, const AudioFormat& afmt,
     const std::vector<FilterSourceFrame>& frames,
     const std::vector<FilterAudioFrame>& audioFrames,
-    const DecoderSetting& decoderSetting) {
+    const DecoderSetting& decoderSetting,
+    const tstring& seekIndexPath) {
     File file(savepath, _T("wb"));
     file.writeArray(std::vector<tchar>(srcpath.begin(), srcpath.end()));
     file.writeArray(std::vector<tchar>(audiopath.begin(), audiopath.end()));
@@ -684,9 +1257,109 @@ void SaveAMTSource(
     file.writeArray(frames);
     file.writeArray(audioFrames);
     file.writeValue(decoderSetting);
+    file.writeArray(std::vector<tchar>(seekIndexPath.begin(), seekIndexPath.end()));
+
+    // シークインデックスの初期値を作っておく
+    AMTSeekIndex index;
+    index.init(frames);
+    SaveAMTSeekIndex(seekIndexPath, index);
+}
+
+void AMTSeekIndex::init(const std::vector<FilterSourceFrame>& frames) {
+    // 最初はキーフレームからデコードすればよいとしておく
+    // 前方デコードの閾値は最長GOPの長さにする
+    // ただし、キャッシュサイズが閾値に比例するので長いGOPのソースでは制限する
+    //（それより長い場合はシークで分かった時に延ばす）
+    seekDistance = 10;
+    seekFrames.resize(frames.size());
+    for (int i = 0; i < (int)frames.size(); ++i) {
+        seekFrames[i] = frames[i].keyFrame;
+        seekDistance = std::max(seekDistance, i - frames[i].keyFrame + 1);
+    }
+    seekDistance = std::min<int>(seekDistance, MAX_INITIAL_SEEK_DISTANCE);
+    failedFrames.clear();
+}
+
+void AMTSeekIndex::merge(const AMTSeekIndex& other) {
+    seekDistance = std::max(seekDistance, other.seekDistance);
+    for (int i = 0; i < (int)seekFrames.size(); ++i) {
+        seekFrames[i] = std::min(seekFrames[i], other.seekFrames[i]);
+    }
+    std::map<int, int> failedMap(failedFrames.begin(), failedFrames.end());
+    failedMap.insert(other.failedFrames.begin(), other.failedFrames.end());
+    failedFrames.assign(failedMap.begin(), failedMap.end());
+}
+
+void SaveAMTSeekIndex(const tstring& path, const AMTSeekIndex& index) {
+    // 読み込み中のインスタンスが壊れたファイルを見ないように別名で書いてから置き換える
+    // 一時ファイル名は他のプロセス・インスタンスと被らないようにする
+    static std::atomic<int> tmpCounter(0);
+#ifdef _WIN32
+    const unsigned pid = (unsigned)GetCurrentProcessId();
+#else
+    const unsigned pid = (unsigned)getpid();
+#endif
+    tstring tmppath = path + StringFormat(_T(".%u.%d.tmp"), pid, tmpCounter++);
+    {
+        File file(tmppath, _T("wb"));
+        file.writeValue(index.seekDistance);
+        file.writeArray(index.seekFrames);
+        file.writeArray(index.failedFrames);
+    }
+#ifdef _WIN32
+    // _trenameは置き換え先が存在すると失敗するのでMoveFileExで置き換える
+    if (MoveFileExW(tmppath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) == 0) {
+        _tremove(tmppath.c_str());
+        THROWF(IOException, "シークインデックスを置き換えられません: %s", path);
+    }
+#else
+    if (_trename(tmppath.c_str(), path.c_str()) != 0) {
+        _tremove(tmppath.c_str());
+        THROWF(IOException, "シークインデックスを置き換えられません: %s", path);
+    }
+#endif
+}
+
+bool LoadAMTSeekIndex(const tstring& path, int numFrames, AMTSeekIndex& index) {
+    if (path.size() == 0 || File::exists(path) == false) {
+        return false;
+    }
+    try {
+        File file(path, _T("rb"));
+        index.seekDistance = file.readValue<int>();
+        if (index.seekDistance <= 0 || file.readValue<int64_t>() != numFrames) {
+            return false;
+        }
+        // フレーム数をもう一度読むため戻る
+        file.seek(sizeof(int), SEEK_SET);
+        index.seekFrames = file.readArray<int>();
+        index.failedFrames = file.readArray<std::pair<int, int>>();
+    } catch (const Exception&) {
+        // 壊れている場合は使わない（作り直す）
+        return false;
+    } catch (const std::exception&) {
+        // 長さが壊れていて確保できなかった
+        return false;
+    }
+    // 壊れた値でframesの範囲外を参照しないようにチェック
+    for (int i = 0; i < numFrames; ++i) {
+        if (index.seekFrames[i] < 0 || index.seekFrames[i] > i) {
+            return false;
+        }
+    }
+    for (const auto& failed : index.failedFrames) {
+        if (failed.first < 0 || failed.first >= numFrames || failed.second < 0 || failed.second >= numFrames) {
+            return false;
+        }
+    }
+    return true;
+}
+
+PClip LoadAMTSource(const tstring& loadpath, const char* filterdesc, bool outputQP, int threads, int decodeAhead, int numDecoders, int cacheMB, IScriptEnvironment* env) {
+    return LoadAMTSource(*g_ctx_for_plugin_filter, loadpath, filterdesc, outputQP, threads, decodeAhead, numDecoders, cacheMB, env);
 }
 
-PClip LoadAMTSource(const tstring& loadpath, const char* filterdesc, bool outputQP, int threads, IScriptEnvironment* env) {
+PClip LoadAMTSource(AMTContext& ctx, const tstring& loadpath, const char* filterdesc, bool outputQP, int threads, int decodeAhead, int numDecoders, int cacheMB, IScriptEnvironment* env) {
     File file(loadpath, _T("rb"));
     auto srcpathv = file.readArray<tchar>();
     tstring srcpath(srcpathv.begin(), srcpathv.end());
@@ -698,9 +1371,12 @@ PClip LoadAMTSource(const tstring& loadpath, const char* filterdesc, bool output
     data->frames = file.readArray<FilterSourceFrame>();
     data->audioFrames = file.readArray<FilterAudioFrame>();
     DecoderSetting decoderSetting = file.readValue<DecoderSetting>();
-    AMTSource* src = new AMTSource(*g_ctx_for_plugin_filter,
-        srcpath, audiopath, vfmt, afmt, data->frames, data->audioFrames, decoderSetting, threads, filterdesc, outputQP, env);
+    auto seekIndexPathv = file.readArray<tchar>();
+    tstring seekIndexPath(seekIndexPathv.begin(), seekIndexPathv.end());
+    AMTSource* src = new AMTSource(ctx,
+        srcpath, audiopath, vfmt, afmt, data->frames, data->audioFrames, decoderSetting, threads, filterdesc, outputQP, decodeAhead, numDecoders, cacheMB, env);
     src->TransferStreamInfo(std::move(data));
+    src->SetSeekIndex(seekIndexPath);
     return src;
 }
 
@@ -712,7 +1388,10 @@ AVSValue CreateAMTSource(AVSValue args, void* user_data, IScriptEnvironment* env
     const char* filterdesc = args[1].AsString("");
     const bool outputQP = args[2].AsBool(true);
     const int threads = args[3].AsInt(0);
-    return LoadAMTSource(filename, filterdesc, outputQP, threads, env);
+    const int decodeAhead = args[4].AsInt(8);
+    const int numDecoders = args[5].AsInt(1);
+    const int cacheMB = args[6].AsInt(256);
+    return LoadAMTSource(filename, filterdesc, outputQP, threads, decodeAhead, numDecoders, cacheMB, env);
 }
 
 /*
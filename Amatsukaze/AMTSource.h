@@ -16,10 +16,13 @@
 #include <vector>
 #include <array>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <set>
 #include <deque>
 #include <unordered_map>
 #include "StreamReform.h"
+#include "AudioEncoder.h"
 #include "ReaderWriterFFmpeg.h"
 
 typedef int64_t __int64;
@@ -43,12 +46,39 @@ struct AMTSourceData {
     std::vector<FilterAudioFrame> audioFrames;
 };
 
+// シーク用インデックス
+// 分割時に作成して、AMTSourceがシークで分かったことを書き戻す
+// 同じ中間ファイルを読む全てのAMTSourceで共有する
+struct AMTSeekIndex {
+    // 初期値として使うGOP長の上限
+    enum { MAX_INITIAL_SEEK_DISTANCE = 60 };
+    // 前方デコードで進むかシークするかの閾値
+    int seekDistance;
+    // フレーム毎のシーク先フレーム（ここからデコードすればそのフレームまで到達できる）
+    std::vector<int> seekFrames;
+    // デコードできないフレームと置換先フレーム
+    std::vector<std::pair<int, int>> failedFrames;
+
+    void init(const std::vector<FilterSourceFrame>& frames);
+    // 他のインスタンスが書き戻した結果とマージする
+    void merge(const AMTSeekIndex& other);
+};
+
+void SaveAMTSeekIndex(const tstring& path, const AMTSeekIndex& index);
+
+// ないか、フレーム数が合わないか壊れている場合はfalse
+bool LoadAMTSeekIndex(const tstring& path, int numFrames, AMTSeekIndex& index);
+
 class AMTSource : public IClip, AMTObject {
     const std::vector<FilterSourceFrame>& frames;
     const std::vector<FilterAudioFrame>& audioFrames;
     DecoderSetting decoderSetting;
     std::string filterdesc;
     int decodeThreads;
+    // 連続アクセス時に先読みデコードするフレーム数（0で先読みしない）
+    int decodeAhead;
+    // 並列デコードするデコーダ数（1以下で並列デコードしない）
+    int numDecoders;
     int audioSamplesPerFrame;
     bool interlaced;
 
@@ -67,13 +97,150 @@ class AMTSource : public IClip, AMTObject {
 
     std::unique_ptr<AMTSourceData> storage;
 
+    // フレームキャッシュ
+    // フレーム番号でハッシュ引きし、アクセス順の双方向リストでLRU管理する
     struct CacheFrame {
         PVideoFrame data;
         int key;
+        size_t bytes;
+        CacheFrame* newer;
+        CacheFrame* older;
+    };
+
+    std::unordered_map<int, std::unique_ptr<CacheFrame>> frameCache;
+    CacheFrame* newestFrame;
+    CacheFrame* oldestFrame;
+    // キャッシュ中のフレームの合計バイト数
+    size_t cacheBytes;
+    // 1フレームの最大バイト数
+    size_t maxFrameBytes;
+    // SetCacheHints(CACHE_WINDOW)で要求されたフレーム数
+    int cacheWindow;
+    // キャッシュの上限バイト数
+    size_t cacheLimitBytes;
+    // キャッシュの最大使用バイト数（統計用）
+    size_t peakCacheBytes;
+
+    int64_t numCacheHits;
+    int64_t numCacheMisses;
+    int64_t numCacheEvictions;
+
+    // デコード済み（フィルタ・フレーム作成前）のフレーム
+    struct DecodedFrame {
+        Frame frame;
+        // シーク後最初のキーフレームのPTS（まだなければ-1）
+        int64_t keyFramePTS;
     };
 
-    std::map<int, CacheFrame*> frameCache;
-    std::deque<CacheFrame*> recentAccessed;
+    // 連続アクセス時にパケットの読み込みとデコードを先行して行うスレッド
+    // 動いている間はinputCtx,codecCtxはこのスレッドだけが触る
+    // フレームの作成（env使用）は呼び出し側スレッドで行う
+    class DecodeAheadThread : private ThreadBase {
+    public:
+        DecodeAheadThread(AMTSource& this_, int maxFrames);
+        ~DecodeAheadThread();
+
+        bool isActive() const;
+        // 現在のストリーム位置から先読みを開始
+        void resume();
+        // 先読みを止めて、先読み済みのフレームは捨てる
+        void pause();
+        // 次のデコード済みフレームを取得 ストリーム終端ならfalse
+        bool get(DecodedFrame& frame);
+
+    protected:
+        virtual void run();
+
+    private:
+        AMTSource& this_;
+        int maxFrames;
+        std::deque<DecodedFrame> queue;
+        int64_t keyFramePTS;
+        bool active;
+        bool busy;
+        bool eof;
+        bool canceled;
+        std::mutex mtx;
+        std::condition_variable cond;
+
+        // パケットを1つ読んでデコードする
+        void decodePacket();
+    };
+
+    std::unique_ptr<DecodeAheadThread> aheadThread;
+
+    // GOP区切りの区間ごとに独立したデコーダで並列にデコードする
+    // デコーダ毎にInputContextとCodecContextを持つ
+    // 区間は先頭から順に割り当てて、呼び出し側は区間順に取り出すので出力は順番通りになる
+    class SegmentDecoder {
+    public:
+        SegmentDecoder(AMTSource& this_, const tstring& srcpath, int numDecoders, IScriptEnvironment* env);
+        ~SegmentDecoder();
+
+        // nがデコード中もしくはデコード済みの区間に入っているか
+        bool isInWindow(int n);
+
+        // フレームnを取得（必要なら区間のデコード完了を待つ）
+        // デコードできていない場合はfalse
+        bool get(int n, Frame& top, Frame& bottom);
+
+    private:
+        struct SegmentFrame {
+            Frame top;
+            Frame bottom;
+            bool valid;
+        };
+        struct Segment {
+            int index;
+            int begin, end; // フレーム範囲
+            // シーク先フレーム（区間作成時にシークインデックスから決めて、デコード後は実際に到達できた位置）
+            int seekFrame;
+            std::vector<SegmentFrame> frames;
+            bool done;
+            std::atomic<bool> canceled;
+        };
+        typedef std::shared_ptr<Segment> SegmentPtr;
+
+        class Worker : private ThreadBase {
+        public:
+            Worker(SegmentDecoder& parent, const tstring& srcpath, int threads, IScriptEnvironment* env);
+            ~Worker();
+        protected:
+            virtual void run();
+        private:
+            SegmentDecoder& parent;
+            AMTSource& this_;
+            InputContext inputCtx;
+            CodecContext codecCtx;
+            AVStream *videoStream;
+
+            void decodeSegment(Segment& seg);
+            // keyNumからシークしてデコードする シークできなかったらfalse
+            bool decodeFrom(Segment& seg, int keyNum, int& lastDecodeFrame);
+        };
+
+        AMTSource& this_;
+        // 区間の先頭フレーム番号（キーフレーム）
+        std::vector<int> segmentStarts;
+        // 取り出し待ちの区間（区間順）
+        std::deque<SegmentPtr> window;
+        // まだデコードを始めていない区間
+        std::deque<SegmentPtr> pending;
+        int nextSegment;
+        bool finished;
+        std::mutex mtx;
+        std::condition_variable cond;
+        std::vector<std::unique_ptr<Worker>> workers;
+
+        int findSegment(int n) const;
+        void fillWindow();
+        void clearWindow();
+    };
+
+    std::unique_ptr<SegmentDecoder> segmentDecoder;
+
+    // 直前にGetFrameで要求されたフレーム
+    int lastRequestFrame;
 
     // �f�R�[�h�ł��Ȃ������t���[���̒u���惊�X�g
     std::map<int, int> failedMap;
@@ -82,10 +249,14 @@ class AMTSource : public IClip, AMTObject {
 
     std::mutex mutex;
 
-    File waveFile;
+    std::unique_ptr<WaveSource> waveSource;
 
     int seekDistance;
 
+    tstring seekIndexPath;
+    AMTSeekIndex seekIndex;
+    bool seekIndexUpdated;
+
     // OnFrameDecoded�Œ��O�Ƀf�R�[�h���ꂽ�t���[��
     // �܂��f�R�[�h���ĂȂ��ꍇ��-1
     int lastDecodeFrame;
@@ -101,6 +272,8 @@ class AMTSource : public IClip, AMTObject {
 
     void MakeCodecContext(IScriptEnvironment* env);
 
+    void OpenDecoder(CodecContext& codec, AVStream* stream, int threads, IScriptEnvironment* env);
+
 #if ENABLE_FFMPEG_FILTER
     void MakeFilterGraph(IScriptEnvironment* env);
 #endif
@@ -186,16 +359,43 @@ class AMTSource : public IClip, AMTObject {
     void OnFrameDecoded(Frame& frame, IScriptEnvironment* env);
 #endif
 
+    enum {
+        PTS_UNKNOWN = -1, // 一致するフレームがない
+        PTS_BEFORE = -2,  // 最初より前
+    };
+
+    // PTSに対応するフレーム番号（最後より後ろだった場合はvi.num_frames）
+    int PTSToFrameIndex(int64_t pts) const;
+
     void OnFrameOutput(Frame& frame, IScriptEnvironment* env);
 
     void UpdateAccessed(CacheFrame* frame);
 
+    void UnlinkFrame(CacheFrame* frame);
+
+    // キャッシュ容量（バイト）
+    size_t GetCacheLimitBytes() const;
+
     PVideoFrame ForceGetFrame(int n, IScriptEnvironment* env);
 
     void DecodeLoop(int goal, IScriptEnvironment* env);
 
+    void DecodeLoopAhead(int goal, IScriptEnvironment* env);
+
+    // デコーダから出てきたフレームを処理
+    void OnFrameReceived(Frame& frame, int64_t keyFramePTS, IScriptEnvironment* env);
+
+    // ストリームを全て読み取った
+    void OnStreamEnd(IScriptEnvironment* env);
+
     void registerFailedFrames(int begin, int end, int replace, IScriptEnvironment* env);
 
+    // keyNumからのデコードでフレームnに到達できなかったときに次に試すシーク先
+    int getRetrySeekFrame(int keyNum) const;
+
+    // keyNumからデコードしてフレームnに到達できたのでシーク距離とシーク先に反映する
+    void updateSeekIndex(int n, int keyNum);
+
 public:
     AMTSource(AMTContext& ctx,
         const tstring& srcpath,
@@ -207,12 +407,17 @@ public:
         const int threads,
         const char* filterdesc,
         bool outputQP,
+        int decodeAhead,
+        int numDecoders,
+        int cacheMB,
         IScriptEnvironment* env);
 
     ~AMTSource();
 
     void TransferStreamInfo(std::unique_ptr<AMTSourceData>&& streamInfo);
 
+    void SetSeekIndex(const tstring& path);
+
     PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* env);
 
     void __stdcall GetAudio(void* buf, __int64 start, __int64 count, IScriptEnvironment* env);
@@ -233,9 +438,13 @@ void SaveAMTSource(
     const VideoFormat& vfmt, const AudioFormat& afmt,
     const std::vector<FilterSourceFrame>& frames,
     const std::vector<FilterAudioFrame>& audioFrames,
-    const DecoderSetting& decoderSetting);
+    const DecoderSetting& decoderSetting,
+    const tstring& seekIndexPath);
+
+PClip LoadAMTSource(const tstring& loadpath, const char* filterdesc, bool outputQP, int threads, int decodeAhead, int numDecoders, int cacheMB, IScriptEnvironment* env);
 
-PClip LoadAMTSource(const tstring& loadpath, const char* filterdesc, bool outputQP, IScriptEnvironment* env);
+// プラグインとしてではなく直接使う場合
+PClip LoadAMTSource(AMTContext& ctx, const tstring& loadpath, const char* filterdesc, bool outputQP, int threads, int decodeAhead, int numDecoders, int cacheMB, IScriptEnvironment* env);
 
 AVSValue CreateAMTSource(AVSValue args, void* user_data, IScriptEnvironment* env);
 
@@ -51,7 +51,7 @@ extern "C" __declspec(dllexport) const char* __stdcall AvisynthPluginInit3(IScri
         g_av_initialized = true;
     }
 
-    env->AddFunction("AMTSource", "s[filter]s[outqp]b[threads]i", av::CreateAMTSource, 0);
+    env->AddFunction("AMTSource", "s[filter]s[outqp]b[threads]i[ahead]i[decoders]i[cachemb]i", av::CreateAMTSource, 0);
 
     //env->AddFunction("AMTAnalyzeLogo", "cs[maskratio]i", logo::AMTAnalyzeLogo::Create, 0);
     //env->AddFunction("AMTEraseLogo", "ccs[logof]s[mode]i[maxfade]i", logo::AMTEraseLogo::Create, 0);
@@ -81,9 +81,24 @@ static void printHelp(const tchar* bin) {
         "  --ignore-nicojk-error ニコニコ実況取得でエラーが発生しても処理を続行する\n"
         "  --no-delogo         ロゴ消しをしない（デフォルトはロゴがある場合は消します）\n"
         "  --parallel-logo-analysis 並列ロゴ解析\n"
+        "  --parallel-ts-analysis TS解析をストリームごとに並列で行う\n"
+        "  --mmap-input        入力TSをメモリマップで読み込む\n"
+        "  --lazy-wave         解析用音声のPCMを一時ファイルに書き出さず、使う時にAACからデコードする\n"
+        "                      戻ったり飛んだりして読む所は8フレーム手前からデコードし直すため\n"
+        "                      PCMが一時ファイルの場合と完全には一致しないことがある\n"
+        "  --source-decoders <数値> 中間ファイルの映像をGOP区間ごとに並列でデコードするデコーダ数[1]\n"
+        "  --source-cache-size <数値> 中間ファイルの映像のデコード済みフレームを保持するキャッシュの上限(MB)[256]\n"
+        "  --parallel-encode <数値> 出力ファイルを同時にエンコードする数[1]\n"
+        "  --parallel-encode-cpus <数値> 並列エンコードで使う論理CPU数。割り当てCPUを同時エンコード数で分割する[0:制限なし]\n"
+        "  --overlap-stages    音声エンコード・字幕生成・Muxを映像エンコードと並行して行う\n"
+        "  --chunk-encode <数値> 映像をシーンチェンジ位置で指定数に分割して同時にエンコードし結合する\n"
+        "                      x264/x265/SVT-AV1の1パスCFR出力のみ対応[0:分割しない]\n"
         "  --loose-logo-detection ロゴ検出判定しきい値を低くします\n"
         "  --max-fade-length <数値> ロゴの最大フェードフレーム数[16]\n"
         "  --chapter-exe <パス> chapter_exe.exeへのパス\n"
+        "  --chapter-exe-builtin 無音・シーンチェンジ解析をchapter_exeを使わずロゴ解析と同じデコードで行う\n"
+        "                      無音区間はchapter_exeと同じ判定だが、シーンチェンジ位置は間引いた輝度差による\n"
+        "                      近似なのでchapter_exeと一致しないことがある\n"
         "  --jls <パス>         join_logo_scp.exeへのパス\n"
         "  --jls-cmd <パス>    join_logo_scpのコマンドファイルへのパス\n"
         "  --jls-option <オプション>    join_logo_scpのコマンドファイルへのパス\n"
@@ -213,6 +228,9 @@ static std::unique_ptr<ConfigWrapper> parseArgs(AMTContext& ctx, int argc, const
     conf.outPipe = INVALID_HANDLE_VALUE;
     conf.maxFadeLength = 16;
     conf.numEncodeBufferFrames = 16;
+    conf.numParallelEncodes = 1;
+    conf.numSourceDecoders = 1;
+    conf.sourceCacheSizeMB = 256;
     conf.useMKVWhenSubExist = false;
     bool nicojk = false;
 
@@ -349,6 +367,14 @@ static std::unique_ptr<ConfigWrapper> parseArgs(AMTContext& ctx, int argc, const
             }
         } else if (key == _T("-eb") || key == _T("--encode-buffer")) {
             conf.numEncodeBufferFrames = std::stoi(getParam(argc, argv, i++));
+        } else if (key == _T("--parallel-encode")) {
+            conf.numParallelEncodes = std::stoi(getParam(argc, argv, i++));
+        } else if (key == _T("--parallel-encode-cpus")) {
+            conf.numEncodeCPUs = std::stoi(getParam(argc, argv, i++));
+        } else if (key == _T("--overlap-stages")) {
+            conf.overlapStages = true;
+        } else if (key == _T("--chunk-encode")) {
+            conf.numEncodeChunks = std::stoi(getParam(argc, argv, i++));
         } else if (key == _T("--ignore-no-logo")) {
             conf.ignoreNoLogo = true;
         } else if (key == _T("--ignore-no-drcsmap")) {
@@ -363,6 +389,16 @@ static std::unique_ptr<ConfigWrapper> parseArgs(AMTContext& ctx, int argc, const
             conf.noDelogo = true;
         } else if (key == _T("--parallel-logo-analysis")) {
             conf.parallelLogoAnalysis = true;
+        } else if (key == _T("--parallel-ts-analysis")) {
+            conf.parallelTsAnalysis = true;
+        } else if (key == _T("--mmap-input")) {
+            conf.mmapInput = true;
+        } else if (key == _T("--source-decoders")) {
+            conf.numSourceDecoders = std::stoi(getParam(argc, argv, i++));
+        } else if (key == _T("--source-cache-size")) {
+            conf.sourceCacheSizeMB = std::stoi(getParam(argc, argv, i++));
+        } else if (key == _T("--lazy-wave")) {
+            conf.lazyWave = true;
         } else if (key == _T("--timefactor")) {
             const auto arg = getParam(argc, argv, i++);
             int ret = sscanfT(arg.c_str(), _T("%lf"), &conf.x265TimeFactor);
@@ -384,6 +420,8 @@ static std::unique_ptr<ConfigWrapper> parseArgs(AMTContext& ctx, int argc, const
             conf.chapterExePath = pathNormalize(getParam(argc, argv, i++));
         } else if (key == _T("--chapter-exe-options")) {
             conf.chapterExeOptions = getParam(argc, argv, i++);
+        } else if (key == _T("--chapter-exe-builtin")) {
+            conf.chapterExeBuiltin = true;
         } else if (key == _T("--jls")) {
             conf.joinLogoScpPath = pathNormalize(getParam(argc, argv, i++));
         } else if (key == _T("--jls-cmd")) {
@@ -588,6 +626,14 @@ static int amatsukazeTranscodeMain(AMTContext& ctx, const ConfigWrapper& setting
             detectSubtitleMain(ctx, setting);
         else if (mode == _T("probe_audio"))
             detectAudioMain(ctx, setting);
+        else if (mode == _T("test_perf_tssync"))
+            test::TsSyncPerformance(ctx, setting);
+        else if (mode == _T("test_logodif"))
+            test::LogoDifKernel(ctx, setting);
+        else if (mode == _T("test_tnr"))
+            test::TemporalNRKernel(ctx, setting);
+        else if (mode == _T("test_scdet"))
+            test::SilenceSceneDetect(ctx, setting);
 /*
         else if (mode == _T("test_print_crc"))
             test::PrintCRCTable(ctx, setting);
@@ -60,6 +60,14 @@ int EncoderOptionParse(AMTContext& ctx, const ConfigWrapper& setting);
 
 int DecodePerformance(AMTContext& ctx, const ConfigWrapper& setting);
 
+int TsSyncPerformance(AMTContext& ctx, const ConfigWrapper& setting);
+
+int LogoDifKernel(AMTContext& ctx, const ConfigWrapper& setting);
+
+int TemporalNRKernel(AMTContext& ctx, const ConfigWrapper& setting);
+
+int SilenceSceneDetect(AMTContext& ctx, const ConfigWrapper& setting);
+
 int BitrateZones(AMTContext& ctx, const ConfigWrapper& setting);
 
 int BitrateZonesBug(AMTContext& ctx, const ConfigWrapper& setting);
@@ -0,0 +1,322 @@
+/**
+* Amtasukaze Test Implementation
+* Copyright (c) 2017-2019 Nekopanda
+*
+* This software is released under the MIT License.
+* http://opensource.org/licenses/mit-license.php
+*/
+
+// UtVideoȂǂɈˑ݂̃\[XŃrhłeXg
+// iAmatsukazeTestImpl.cppLinuxł̓rhȂ̂łɒuj
+
+#include "AmatsukazeTestImpl.h"
+#include "Logoframe.h"
+#include "TemporalNRKernel.h"
+#include "CMAnalyze.h"
+
+/* static */ int test::TsSyncPerformance(AMTContext& ctx, const ConfigWrapper& setting) {
+    enum {
+        MAX_BYTES = 256 * 1024 * 1024,
+        NOISE_BYTES = 16 * 1024 * 1024,
+        NUM_LOOPS = 10,
+    };
+
+    // ĂTSi̓t@Cj
+    File srcfile(setting.getSrcFilePath(), _T("rb"));
+    std::vector<uint8_t> ts((size_t)std::min<int64_t>(srcfile.size(), MAX_BYTES));
+    srcfile.read(MemoryChunk(ts.data(), ts.size()));
+    int numPackets = (int)(ts.size() / TS_PACKET_LENGTH);
+
+    // MG[œȂԂ͂f[^
+    std::vector<uint8_t> noise(NOISE_BYTES);
+    uint32_t seed = 1;
+    for (auto& b : noise) {
+        seed = seed * 1103515245 + 12345;
+        b = (uint8_t)(seed >> 16);
+    }
+
+    struct Kernel {
+        const char* name;
+        int(*count)(const uint8_t* ptr, int numPackets);
+        int(*find)(const uint8_t* ptr, int length, int numPackets);
+    };
+    std::vector<Kernel> kernels = { { "C", CountSyncBytesC, FindSyncOffsetC } };
+    if (IsAVX2Available()) {
+        kernels.push_back({ "AVX2", CountSyncBytesAVX2, FindSyncOffsetAVX2 });
+    }
+
+    Stopwatch sw;
+    for (const auto& kernel : kernels) {
+        int count = 0;
+        sw.start();
+        for (int i = 0; i < NUM_LOOPS; ++i) {
+            count = kernel.count(ts.data(), numPackets);
+        }
+        double countSec = sw.getAndReset();
+
+        int offset = 0;
+        sw.start();
+        for (int i = 0; i < NUM_LOOPS; ++i) {
+            offset = kernel.find(noise.data(), (int)noise.size(), 8);
+        }
+        double findSec = sw.getAndReset();
+
+        printf("%s: count %d/%d packets %.1f MB/s, resync offset %d %.1f MB/s\n", kernel.name,
+            count, numPackets, ts.size() * NUM_LOOPS / countSec / (1024 * 1024),
+            offset, noise.size() * NUM_LOOPS / findSec / (1024 * 1024));
+    }
+
+    return 0;
+}
+
+/* static */ int test::LogoDifKernel(AMTContext& ctx, const ConfigWrapper& setting) {
+    enum {
+        WIDTH = 1920,
+        HEIGHT = 1080,
+        LOGO_X = 1600,
+        LOGO_Y = 40,
+        LOGO_W = 240,
+        LOGO_H = 120,
+        NUM_FRAMES = 300,
+    };
+
+    if (!IsAVX2Available()) {
+        printf("AVX2 is not available\n");
+        return 0;
+    }
+
+    uint32_t seed = 1;
+    auto random = [&]() {
+        seed = seed * 1103515245 + 12345;
+        return (int)(seed >> 16);
+    };
+
+    // Sf[^
+    const int numPixels = LOGO_W * LOGO_H;
+    std::vector<short> dp_y(numPixels), y(numPixels), area_y(numPixels);
+    std::vector<char> dif_y_col(numPixels), dif_y_row(numPixels);
+    for (int i = 0; i < numPixels; ++i) {
+        dp_y[i] = (short)(random() % LOGO_MAX_DP);
+        y[i] = (short)(random() % (256 << 4));
+        dif_y_col[i] = (char)(random() % 2);
+        // [2sƉE2f̓XJ[łłSf[^͈̔͊OQƂ̂ŖɂĂ
+        dif_y_row[i] = (i < numPixels - LOGO_W * 2) ? (char)(random() % 2) : 0;
+    }
+    dif_y_col[numPixels - 1] = dif_y_col[numPixels - 2] = 0;
+    LOGO_PARAMREC param = LOGO_PARAMREC();
+    param.yx = LOGO_X;
+    param.yy = LOGO_Y;
+    param.yw = LOGO_W;
+    param.yh = LOGO_H;
+    param.dp_y = dp_y.data();
+    param.y = y.data();
+    param.dif_y_col = dif_y_col.data();
+    param.dif_y_row = dif_y_row.data();
+    param.area_y = area_y.data();
+    param.most_logo_y = 128;
+
+    // ̓t@C1920x10808bitPxf[^ƂēǂށiȂ͗j
+    // ^悩ꍇ ffmpeg -i in.ts -pix_fmt gray -f rawvideo out.y Ȃ
+    std::unique_ptr<File> src;
+    if (setting.getSrcFilePath().size() > 0 && File::exists(setting.getSrcFilePath())) {
+        src = std::unique_ptr<File>(new File(setting.getSrcFilePath(), _T("rb")));
+    }
+    std::vector<uint8_t> frame(WIDTH * HEIGHT);
+    std::vector<uint8_t> chkopp(LOGO_W + 8);
+    Stopwatch sw;
+    double sec[2] = { 0, 0 };
+    for (int f = 0; f < NUM_FRAMES; ++f) {
+        if (src == nullptr || src->read(MemoryChunk(frame.data(), frame.size())) != frame.size()) {
+            for (auto& b : frame) {
+                b = (uint8_t)random();
+            }
+        }
+        LOGO_CALCREC calc[2][2];
+        memset(calc, 0, sizeof(calc));
+        for (int simd = 0; simd < 2; ++simd) {
+            calc[simd][0].fade_calcstep = calc[simd][1].fade_calcstep = LOGO_FADE_STEP;
+            LogoCalc_simd = simd;
+            sw.start();
+            LogoCalc_getdif(&calc[simd][0], &calc[simd][1], &param, frame.data(), WIDTH,
+                DEF_LOGO_THRES_YMAX, DEF_LOGO_THRES_YEDGE, DEF_LOGO_THRES_YDIF, DEF_LOGO_THRES_YOFFEDG, chkopp.data());
+            sec[simd] += sw.getAndReset();
+        }
+        LogoCalc_simd = -1;
+        if (memcmp(calc[0], calc[1], sizeof(calc[0])) != 0) {
+            THROWF(TestException, "LogoCalc_getdif result mismatch at frame %d", f);
+        }
+    }
+    printf("LogoCalc_getdif: %d frames matched, C %.3f sec, AVX2 %.3f sec\n", NUM_FRAMES, sec[0], sec[1]);
+
+    return 0;
+}
+
+// ōt[TemporalNRFilterƓōsJ[l
+// XJ[łAVX2ł̏o͂v邩mF
+template <typename T>
+static double TemporalNRKernelTest(int bits, uint32_t& seed) {
+    enum {
+        WIDTH = 1916, // 8̔{łȂŃXJ[ł̒[ʂ
+        HEIGHT = 32,
+        RADIUS = 3,
+        NFRAMES = RADIUS * 2 + 1,
+        NUM_FRAMES = 16,
+    };
+    const int cwidth = WIDTH / 2;
+    const int cheight = HEIGHT / 2;
+    const int maxValue = (1 << bits) - 1;
+    const int thresh = 8 << (bits - 8);
+    auto random = [&]() {
+        seed = seed * 1103515245 + 12345;
+        return (int)(seed >> 16);
+    };
+
+    // Ȃ炩ȉ摜ɃmCY悹Ĕ肪vEsv̗ɂȂ悤ɂ
+    std::vector<std::vector<T>> srcY(NUM_FRAMES), srcU(NUM_FRAMES), srcV(NUM_FRAMES);
+    for (int f = 0; f < NUM_FRAMES; ++f) {
+        auto fill = [&](std::vector<T>& plane, int w, int h) {
+            plane.resize(w * h);
+            for (int y = 0; y < h; ++y) {
+                for (int x = 0; x < w; ++x) {
+                    int v = (((x + y * 3) & 0xFF) << (bits - 8)) + random() % (thresh * 2 + 1) - thresh;
+                    plane[x + y * w] = (T)std::max(0, std::min(maxValue, v));
+                }
+            }
+        };
+        fill(srcY[f], WIDTH, HEIGHT);
+        fill(srcU[f], cwidth, cheight);
+        fill(srcV[f], cwidth, cheight);
+    }
+    float kernel[NFRAMES];
+    for (int i = 0; i < NFRAMES; ++i) {
+        kernel[i] = 1.0f / (1 + std::abs(i - RADIUS));
+    }
+
+    Stopwatch sw;
+    double sec = 0;
+    for (int c = 0; c < NUM_FRAMES; ++c) {
+        // 0:XJ[ 1:AVX2
+        enum { NUM_MODES = 2 };
+        std::vector<T> dstY[NUM_MODES], dstU[NUM_MODES], dstV[NUM_MODES];
+        int srcIdx[NFRAMES];
+        for (int i = 0; i < NFRAMES; ++i) {
+            // 擪ƖTemporalNRFilterƓ[̃t[JԂ
+            srcIdx[i] = std::max(0, std::min(NUM_FRAMES - 1, c - RADIUS + i));
+        }
+        for (int k = 0; k < NUM_MODES; ++k) {
+            dstY[k].assign(WIDTH * HEIGHT, 0);
+            dstU[k].assign(cwidth * cheight, 0);
+            dstV[k].assign(cwidth * cheight, 0);
+        }
+        for (int y = 0; y < HEIGHT; ++y) {
+            const int cy = y >> 1;
+            const bool cout = ((y & 1) == 0);
+            const T* rowY[NFRAMES];
+            const T* rowU[NFRAMES];
+            const T* rowV[NFRAMES];
+            for (int i = 0; i < NFRAMES; ++i) {
+                int f = srcIdx[i];
+                rowY[i] = srcY[f].data() + y * WIDTH;
+                rowU[i] = srcU[f].data() + cy * cwidth;
+                rowV[i] = srcV[f].data() + cy * cwidth;
+            }
+            for (int k = 0; k < NUM_MODES; ++k) {
+                T* dY = dstY[k].data() + y * WIDTH;
+                T* dU = cout ? dstU[k].data() + cy * cwidth : NULL;
+                T* dV = cout ? dstV[k].data() + cy * cwidth : NULL;
+                int x = 0;
+                if (k == 1) {
+                    sw.start();
+                    x = TemporalNRRowAVX2(rowY, rowU, rowV, dY, dU, dV, WIDTH, NFRAMES, RADIUS, thresh, kernel);
+                    sec += sw.getAndReset();
+                }
+                TemporalNRRowC(rowY, rowU, rowV, dY, dU, dV, x, WIDTH, NFRAMES, RADIUS, thresh, kernel);
+            }
+        }
+        if (dstY[0] != dstY[1] || dstU[0] != dstU[1] || dstV[0] != dstV[1]) {
+            THROWF(TestException, "TemporalNR result mismatch (%dbit) at frame %d", bits, c);
+        }
+    }
+    return sec;
+}
+
+/* static */ int test::TemporalNRKernel(AMTContext& ctx, const ConfigWrapper& setting) {
+    if (!IsAVX2Available()) {
+        printf("AVX2 is not available\n");
+        return 0;
+    }
+    uint32_t seed = 1;
+    double sec8 = TemporalNRKernelTest<uint8_t>(8, seed);
+    double sec10 = TemporalNRKernelTest<uint16_t>(10, seed);
+    double sec16 = TemporalNRKernelTest<uint16_t>(16, seed);
+    printf("TemporalNRRow: 8/10/16bit C/AVX2 matched, AVX2 %.3f/%.3f/%.3f sec\n", sec8, sec10, sec16);
+
+    return 0;
+}
+
+struct ChapterExeMute {
+    int start, end;
+    int scPos; // SCPosȂ-1
+};
+
+// chapter_exe̕Wo͌`̃t@C疳ԂǂށiCMAnalyze::readSceneChangesƓ߁j
+static std::vector<ChapterExeMute> ReadChapterExeLog(const tstring& path) {
+    File file(path, _T("r"));
+    std::string str;
+    while (file.getline(str)) {
+        if (starts_with(str, "----")) {
+            break;
+        }
+    }
+    std::regex re0("mute\\s*(\\d+):\\s*(\\d+)\\s*-\\s*(\\d+).*");
+    std::regex re1("\\s*SCPos:\\s*(\\d+).*");
+    std::vector<ChapterExeMute> mutes;
+    while (file.getline(str)) {
+        std::smatch m;
+        if (std::regex_search(str, m, re0)) {
+            ChapterExeMute mute = { std::stoi(m[2].str()), std::stoi(m[3].str()), -1 };
+            mutes.push_back(mute);
+        } else if (std::regex_search(str, m, re1) && mutes.size() > 0) {
+            mutes.back().scPos = std::stoi(m[1].str());
+        }
+    }
+    return mutes;
+}
+
+// ̖EV[`FW͂chapter_exěʂƔr
+// -i AMTSource̒ԃt@CA<>.chapter_exe.txt ɓfchapter_exeŉ͂
+// WóiCM͂̈ꎞt@Cchapter_exeóju
+// Ԃ͈vȂ΂ȂȂBV[`FWʒu͋ߎȂ̂ňv\邾
+/* static */ int test::SilenceSceneDetect(AMTContext& ctx, const ConfigWrapper& setting) {
+    const tstring amtspath = setting.getSrcFilePath();
+    auto expected = ReadChapterExeLog(amtspath + _T(".chapter_exe.txt"));
+
+    SilenceSceneDetector scdet(setting.getChapterExeOptions());
+    if (!AnalyzeSilenceScene(ctx, amtspath, scdet, setting.getNumSourceDecoders(), setting.getSourceCacheSizeMB())) {
+        THROW(TestException, "input is not 8bit YUV or has no audio");
+    }
+    const_cast<ConfigWrapper&>(setting).CreateTempDir();
+    const tstring logpath = setting.getTmpChapterExeOutPath(0);
+    scdet.writeLog(logpath);
+    auto actual = ReadChapterExeLog(logpath);
+
+    if (actual.size() != expected.size()) {
+        THROWF(TestException, "mute zone count mismatch: builtin %d chapter_exe %d", (int)actual.size(), (int)expected.size());
+    }
+    int numMatched = 0;
+    for (int i = 0; i < (int)actual.size(); ++i) {
+        if (actual[i].start != expected[i].start || actual[i].end != expected[i].end) {
+            THROWF(TestException, "mute zone %d mismatch: builtin %d-%d chapter_exe %d-%d",
+                i + 1, actual[i].start, actual[i].end, expected[i].start, expected[i].end);
+        }
+        if (actual[i].scPos == expected[i].scPos) {
+            ++numMatched;
+        } else {
+            printf("mute%2d: SCPos builtin %d chapter_exe %d\n", i + 1, actual[i].scPos, expected[i].scPos);
+        }
+    }
+    printf("SilenceSceneDetector: %d mute zones matched, SCPos matched %d/%d\n",
+        (int)actual.size(), numMatched, (int)actual.size());
+
+    return 0;
+}
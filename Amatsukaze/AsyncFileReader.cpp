@@ -0,0 +1,167 @@
+/**
+* Read-ahead file reader
+* Copyright (c) 2017-2019 Nekopanda
+*
+* This software is released under the MIT License.
+* http://opensource.org/licenses/mit-license.php
+*/
+
+#include "AsyncFileReader.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+AsyncFileReader::AsyncFileReader(const File& file, size_t blockSize, int queueDepth, bool useMmap)
+    : file_(file)
+    , blockSize_(blockSize)
+    , queueDepth_(std::max(1, queueDepth))
+    , blocks_(queueDepth_ + 1)
+    , readIdx_(0)
+    , writeIdx_(0)
+    , numFilled_(0)
+    , eof_(false)
+    , canceled_(false)
+    , error_(false)
+    , mapBase_(nullptr)
+    , mapSize_(0)
+    , mapPos_(0)
+    , releasedPos_(0) {
+    if (useMmap && mapFile()) {
+        return;
+    }
+    for (auto& block : blocks_) {
+        block.data = std::unique_ptr<uint8_t[]>(new uint8_t[blockSize_]);
+        block.length = 0;
+    }
+    start();
+}
+
+AsyncFileReader::~AsyncFileReader() {
+    if (isMapped()) {
+#ifndef _WIN32
+        munmap(mapBase_, mapSize_);
+#endif
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        canceled_ = true;
+        cond_.notify_all();
+    }
+    join();
+}
+
+MemoryChunk AsyncFileReader::read() {
+    if (isMapped()) {
+        return readMapped();
+    }
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (numFilled_ == 0 && !eof_ && !error_) {
+        cond_.wait(lock);
+    }
+    if (numFilled_ == 0) {
+        if (error_) {
+            THROWF(IOException, "%s", errMessage_.c_str());
+        }
+        return MemoryChunk(blocks_[readIdx_].data.get(), 0);
+    }
+    // 前回返したブロックはここで読み込み側に戻る
+    Block& block = blocks_[readIdx_];
+    readIdx_ = (readIdx_ + 1) % (int)blocks_.size();
+    --numFilled_;
+    cond_.notify_all();
+    return MemoryChunk(block.data.get(), block.length);
+}
+
+size_t AsyncFileReader::getBlockSize() const {
+    return blockSize_;
+}
+
+bool AsyncFileReader::isMapped() const {
+    return mapBase_ != nullptr;
+}
+
+bool AsyncFileReader::mapFile() {
+#ifdef _WIN32
+    // メモリマップは未対応
+    return false;
+#else
+    int64_t start = file_.pos();
+    int64_t size = file_.size();
+    if (start < 0 || size <= start || (uint64_t)size > SIZE_MAX) {
+        return false;
+    }
+    void* ptr = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, file_.fd(), 0);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+    mapBase_ = (uint8_t*)ptr;
+    mapSize_ = (size_t)size;
+    mapPos_ = (size_t)start;
+    releasedPos_ = 0;
+    madvise(mapBase_, mapSize_, MADV_SEQUENTIAL);
+    return true;
+#endif
+}
+
+MemoryChunk AsyncFileReader::readMapped() {
+#ifdef _WIN32
+    // mapFile()が失敗するので呼ばれない
+    return MemoryChunk();
+#else
+    const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    // 前回返したブロックまでは読み終わっているので解放
+    size_t releaseEnd = mapPos_ / pageSize * pageSize;
+    if (releaseEnd > releasedPos_) {
+        madvise(mapBase_ + releasedPos_, releaseEnd - releasedPos_, MADV_DONTNEED);
+        releasedPos_ = releaseEnd;
+    }
+    size_t length = std::min(blockSize_, mapSize_ - mapPos_);
+    MemoryChunk block(mapBase_ + mapPos_, length);
+    mapPos_ += length;
+    // 次のブロックから先読み
+    if (mapPos_ < mapSize_) {
+        size_t prefetchStart = mapPos_ / pageSize * pageSize;
+        size_t prefetchEnd = std::min(mapSize_, mapPos_ + blockSize_ * queueDepth_);
+        madvise(mapBase_ + prefetchStart, prefetchEnd - prefetchStart, MADV_WILLNEED);
+    }
+    return block;
+#endif
+}
+
+/* virtual */ void AsyncFileReader::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            // numFilled_ < queueDepth_ なら呼び出し側が保持中のブロックとは重ならない
+            while (numFilled_ >= queueDepth_ && !canceled_) {
+                cond_.wait(lock);
+            }
+            if (canceled_) return;
+        }
+        Block& block = blocks_[writeIdx_];
+        size_t readBytes = 0;
+        try {
+            readBytes = file_.read(MemoryChunk(block.data.get(), blockSize_));
+        } catch (const Exception& e) {
+            std::unique_lock<std::mutex> lock(mtx_);
+            errMessage_ = e.message();
+            error_ = true;
+            cond_.notify_all();
+            return;
+        }
+        block.length = readBytes;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            writeIdx_ = (writeIdx_ + 1) % (int)blocks_.size();
+            ++numFilled_;
+            if (readBytes < blockSize_) {
+                eof_ = true;
+            }
+            cond_.notify_all();
+        }
+        if (readBytes < blockSize_) return;
+    }
+}
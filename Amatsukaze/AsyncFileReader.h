@@ -0,0 +1,79 @@
+#pragma once
+
+/**
+* Read-ahead file reader
+* Copyright (c) 2017-2019 Nekopanda
+*
+* This software is released under the MIT License.
+* http://opensource.org/licenses/mit-license.php
+*/
+
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include "StreamUtils.h"
+#include "ProcessThread.h"
+
+// ファイルを別スレッドで先読みしながら先頭から順に読み込む
+// 呼び出し側がデータを処理している間に次のブロックの読み込みを進めておくことで
+// ネットワークストレージ等で読み込み待ちを隠す
+// 読み込みはfileの現在位置から開始する
+// useMmapを指定するとファイルをメモリマップしてマッピングを直接返す（コピーなし）
+// 先読みはmadviseでカーネルに任せ、読み終わった範囲は解放する
+// マップできなかった場合やWindowsではスレッドでの読み込みになる
+class AsyncFileReader : private ThreadBase {
+public:
+    AsyncFileReader(
+        const File& file,
+        size_t blockSize = 4 * 1024 * 1024, // 1回に読み込むバイト数
+        int queueDepth = 2,                 // 先読みするブロック数
+        bool useMmap = false);
+    ~AsyncFileReader();
+
+    // 次のブロックを取得
+    // 返したデータは次のread()呼び出しまで有効
+    // ファイル終端に達するとblockSize未満（0のこともある）が返る
+    MemoryChunk read();
+
+    size_t getBlockSize() const;
+
+    bool isMapped() const;
+
+protected:
+    virtual void run();
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> data;
+        size_t length;
+    };
+
+    const File& file_;
+    size_t blockSize_;
+    int queueDepth_;
+
+    // 呼び出し側が保持中の1ブロック＋先読み分
+    std::vector<Block> blocks_;
+    int readIdx_;  // 次に返すブロック
+    int writeIdx_; // 次に読み込むブロック
+    int numFilled_;
+
+    bool eof_;
+    bool canceled_;
+    bool error_;
+    std::string errMessage_;
+
+    std::mutex mtx_;
+    std::condition_variable cond_;
+
+    // メモリマップ用
+    uint8_t* mapBase_;
+    size_t mapSize_;
+    size_t mapPos_;      // 次に返す位置
+    size_t releasedPos_; // ここより前は解放済み
+
+    bool mapFile();
+    MemoryChunk readMapped();
+};
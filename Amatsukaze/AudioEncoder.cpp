@@ -8,6 +8,7 @@
 
 #include "common.h"
 #include "AudioEncoder.h"
+#include "faad.h"
 
 
 void wave::set4(int8_t dst[4], const char* src) {
@@ -17,6 +18,233 @@ void wave::set4(int8_t dst[4], const char* src) {
     dst[3] = src[3];
 } // namespace wave {
 
+namespace {
+
+const char WAVE_INDEX_MAGIC[8] = { 'A', 'M', 'T', 'W', 'I', 'D', 'X', '1' };
+
+struct WaveIndexEntry {
+    int64_t fileOffset;
+    int64_t waveOffset;
+    int codedDataSize;
+    int waveDataSize;
+    int audioIdx;
+    int reserved;
+};
+
+class FileWaveSource : public WaveSource {
+public:
+    FileWaveSource(const tstring& path)
+        : file_(path, _T("rb")) { }
+
+    virtual void read(int64_t offset, MemoryChunk dst) {
+        file_.seek(offset, SEEK_SET);
+        size_t readBytes = file_.read(dst);
+        if (readBytes < dst.length) {
+            memset(dst.data + readBytes, 0x00, dst.length - readBytes);
+        }
+    }
+
+private:
+    File file_;
+};
+
+// AACフレームを必要な時にデコードする
+// 音声ストリーム毎にデコーダを持ち、順番に読む場合は解析時と同じように連続してデコードする
+// 戻ったり飛んだりした場合はNUM_PREROLLフレーム手前からデコードし直す
+// （デコーダの状態が完全には一致しないので、その場合は解析時のPCMと一致しないことがある）
+class LazyWaveSource : public WaveSource, AMTObject {
+    enum {
+        NUM_PREROLL = 8,
+        NUM_CACHE_FRAMES = 32,
+    };
+public:
+    LazyWaveSource(AMTContext& ctx, const tstring& audiopath, std::vector<WaveIndexEntry>&& index)
+        : AMTObject(ctx)
+        , file_(audiopath, _T("rb"))
+        , index_(std::move(index))
+        , streamPos_(index_.size()) {
+        for (int i = 0; i < (int)index_.size(); ++i) {
+            int audioIdx = index_[i].audioIdx;
+            if (audioIdx >= (int)streams_.size()) {
+                streams_.resize(audioIdx + 1);
+            }
+            streamPos_[i] = (int)streams_[audioIdx].frames.size();
+            streams_[audioIdx].frames.push_back(i);
+        }
+    }
+
+    ~LazyWaveSource() {
+        for (auto& s : streams_) {
+            closeDecoder(s);
+        }
+    }
+
+    virtual void read(int64_t offset, MemoryChunk dst) {
+        uint8_t* ptr = dst.data;
+        size_t remain = dst.length;
+        // offsetを含むフレームを探す（waveOffsetは単調増加）
+        auto it = std::upper_bound(index_.begin(), index_.end(), offset,
+            [](int64_t v, const WaveIndexEntry& e) { return v < e.waveOffset; });
+        int i = std::max(0, (int)(it - index_.begin()) - 1);
+        for (; remain > 0 && i < (int)index_.size(); ++i) {
+            const auto& e = index_[i];
+            int64_t start = offset - e.waveOffset;
+            if (start < 0 || start >= e.waveDataSize) {
+                continue;
+            }
+            const auto& pcm = getFrame(i);
+            size_t bytes = std::min<size_t>(remain, (size_t)(e.waveDataSize - start));
+            memcpy(ptr, pcm.data() + start, bytes);
+            ptr += bytes;
+            remain -= bytes;
+            offset += bytes;
+        }
+        if (remain > 0) {
+            memset(ptr, 0x00, remain);
+        }
+    }
+
+private:
+    struct Stream {
+        NeAACDecHandle hAacDec = NULL;
+        // このストリームのフレーム（index_のインデックス）
+        std::vector<int> frames;
+        // 次にデコードするframesの位置
+        int nextPos = 0;
+        // デコードし直した直後のフレームは正しくないのでこの位置からキャッシュに入れる
+        int validPos = 0;
+        // 直近にデコードしたフレーム（framesの位置とPCM）
+        std::deque<std::pair<int, std::vector<uint8_t>>> cache;
+    };
+
+    File file_;
+    std::vector<WaveIndexEntry> index_;
+    std::vector<int> streamPos_;
+    std::vector<Stream> streams_;
+    std::vector<uint8_t> codedBuffer_;
+
+    const std::vector<uint8_t>& getFrame(int i) {
+        auto& s = streams_[index_[i].audioIdx];
+        int pos = streamPos_[i];
+        for (const auto& c : s.cache) {
+            if (c.first == pos) {
+                return c.second;
+            }
+        }
+        if (pos < s.nextPos || pos > s.nextPos + NUM_PREROLL) {
+            closeDecoder(s);
+            s.nextPos = std::max(0, pos - NUM_PREROLL);
+            // 先頭からなら解析時と同じ
+            s.validPos = (s.nextPos == 0) ? 0 : pos;
+        }
+        while (s.nextPos <= pos) {
+            std::vector<uint8_t> pcm;
+            if (s.cache.size() >= NUM_CACHE_FRAMES) {
+                pcm = std::move(s.cache.front().second);
+                s.cache.pop_front();
+            }
+            decodeFrame(s, index_[s.frames[s.nextPos]], pcm);
+            if (s.nextPos >= s.validPos) {
+                s.cache.emplace_back(s.nextPos, std::move(pcm));
+            }
+            ++s.nextPos;
+        }
+        return s.cache.back().second;
+    }
+
+    // AdtsParserと同じ手順でデコードする
+    void decodeFrame(Stream& s, const WaveIndexEntry& e, std::vector<uint8_t>& pcm) {
+        codedBuffer_.resize(e.codedDataSize);
+        file_.seek(e.fileOffset, SEEK_SET);
+        if (file_.read(MemoryChunk(codedBuffer_.data(), codedBuffer_.size())) != codedBuffer_.size()) {
+            THROW(IOException, "音声フレームを読み込めません");
+        }
+        MemoryChunk frame(codedBuffer_.data(), codedBuffer_.size());
+
+        if (s.hAacDec == NULL) {
+            resetDecoder(s, frame);
+        }
+        NeAACDecFrameInfo frameInfo;
+        void* samples = NeAACDecDecode(s.hAacDec, &frameInfo, frame.data, (unsigned long)frame.length);
+        if (frameInfo.error != 0) {
+            resetDecoder(s, frame);
+            samples = NeAACDecDecode(s.hAacDec, &frameInfo, frame.data, (unsigned long)frame.length);
+        }
+        if (frameInfo.error == 0 && getNumChannels(frameInfo) != 2) {
+            resetDecoder(s, frame);
+            samples = NeAACDecDecode(s.hAacDec, &frameInfo, frame.data, (unsigned long)frame.length);
+        }
+
+        // 解析時と長さが違う場合（シーク直後など）は足りない分をゼロ埋め
+        pcm.assign(e.waveDataSize, 0);
+        if (frameInfo.error == 0 && getNumChannels(frameInfo) == 2) {
+            size_t bytes = std::min<size_t>(pcm.size(), frameInfo.samples * 2);
+            memcpy(pcm.data(), samples, bytes);
+        }
+    }
+
+    static int getNumChannels(const NeAACDecFrameInfo& frameInfo) {
+        return frameInfo.num_front_channels +
+            frameInfo.num_back_channels + frameInfo.num_side_channels + frameInfo.num_lfe_channels;
+    }
+
+    void closeDecoder(Stream& s) {
+        if (s.hAacDec != NULL) {
+            NeAACDecClose(s.hAacDec);
+            s.hAacDec = NULL;
+        }
+    }
+
+    void resetDecoder(Stream& s, MemoryChunk data) {
+        closeDecoder(s);
+
+        s.hAacDec = NeAACDecOpen();
+        NeAACDecConfigurationPtr conf = NeAACDecGetCurrentConfiguration(s.hAacDec);
+        conf->outputFormat = FAAD_FMT_16BIT;
+        conf->downMatrix = 1;
+        NeAACDecSetConfiguration(s.hAacDec, conf);
+
+        unsigned long samplerate;
+        unsigned char channels;
+        if (NeAACDecInit(s.hAacDec, data.data, (unsigned long)data.length, &samplerate, &channels)) {
+            ctx.warn("NeAACDecInitに失敗");
+        }
+    }
+};
+
+} // namespace
+
+std::unique_ptr<WaveSource> OpenWaveSource(AMTContext& ctx, const tstring& wavepath) {
+    File file(wavepath, _T("rb"));
+    char magic[sizeof(WAVE_INDEX_MAGIC)] = { 0 };
+    if (file.read(MemoryChunk((uint8_t*)magic, sizeof(magic))) == sizeof(magic) &&
+        memcmp(magic, WAVE_INDEX_MAGIC, sizeof(magic)) == 0) {
+        auto audiopathv = file.readArray<tchar>();
+        auto index = file.readArray<WaveIndexEntry>();
+        return std::unique_ptr<WaveSource>(new LazyWaveSource(ctx,
+            tstring(audiopathv.begin(), audiopathv.end()), std::move(index)));
+    }
+    return std::unique_ptr<WaveSource>(new FileWaveSource(wavepath));
+}
+
+void WriteWaveIndex(const File& file, const tstring& audiopath,
+    const std::vector<FileAudioFrameInfo>& frames) {
+    std::vector<WaveIndexEntry> index(frames.size());
+    for (int i = 0; i < (int)frames.size(); ++i) {
+        const auto& info = frames[i];
+        auto& e = index[i];
+        e.fileOffset = info.fileOffset;
+        e.waveOffset = info.waveOffset;
+        e.codedDataSize = info.codedDataSize;
+        e.waveDataSize = info.waveDataSize;
+        e.audioIdx = info.audioIdx;
+        e.reserved = 0;
+    }
+    file.write(MemoryChunk((uint8_t*)WAVE_INDEX_MAGIC, sizeof(WAVE_INDEX_MAGIC)));
+    file.writeArray(std::vector<tchar>(audiopath.begin(), audiopath.end()));
+    file.writeArray(index);
+}
+
 void EncodeAudio(AMTContext& ctx, const tstring& encoder_args,
     const tstring& audiopath, const AudioFormat& afmt,
     const std::vector<FilterAudioFrame>& audioFrames) {
@@ -56,22 +284,41 @@ void EncodeAudio(AMTContext& ctx, const tstring& encoder_args,
         }
     }
 
-    File srcFile(audiopath, _T("rb"));
+    // フレーム毎にシーク・読み込み・書き込みするとフレーム数が多いので
+    // BLOCK_FRAMESフレームずつまとめてエンコーダに書き込む
+    // waveOffsetが連続しているフレームは1回で読む
+    enum { BLOCK_FRAMES = 256 };
+    auto srcWave = OpenWaveSource(ctx, audiopath);
     AutoBuffer buffer;
     int frameWaveLength = audioSamplesPerFrame * bytesPerSample * nchannels;
-    MemoryChunk mc = buffer.space(frameWaveLength);
-    mc.length = frameWaveLength;
+    uint8_t* block = buffer.space(frameWaveLength * BLOCK_FRAMES).data;
 
-    for (size_t i = 0; i < audioFrames.size(); ++i) {
-        if (audioFrames[i].waveLength != 0) {
-            // waveがあるなら読む
-            srcFile.seek(audioFrames[i].waveOffset, SEEK_SET);
-            srcFile.read(mc);
-        } else {
-            // ない場合はゼロ埋めする
-            memset(mc.data, 0x00, mc.length);
-        }
-        process->write(mc);
+    for (size_t i = 0; i < audioFrames.size(); ) {
+        size_t numFrames = std::min<size_t>(BLOCK_FRAMES, audioFrames.size() - i);
+        uint8_t* ptr = block;
+        for (size_t k = i; k < i + numFrames; ) {
+            const auto& frame = audioFrames[k];
+            size_t run = 1;
+            if (frame.waveLength != 0) {
+                // waveがあるなら読む
+                while (k + run < i + numFrames &&
+                    audioFrames[k + run].waveLength != 0 &&
+                    audioFrames[k + run].waveOffset == frame.waveOffset + (int64_t)run * frameWaveLength) {
+                    ++run;
+                }
+                srcWave->read(frame.waveOffset, MemoryChunk(ptr, run * frameWaveLength));
+            } else {
+                // ない場合はゼロ埋めする
+                while (k + run < i + numFrames && audioFrames[k + run].waveLength == 0) {
+                    ++run;
+                }
+                memset(ptr, 0x00, run * frameWaveLength);
+            }
+            ptr += run * frameWaveLength;
+            k += run;
+        }
+        process->write(MemoryChunk(block, numFrames * frameWaveLength));
+        i += numFrames;
     }
 
     process->finishWrite();
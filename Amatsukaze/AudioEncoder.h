@@ -29,6 +29,24 @@ void set4(int8_t dst[4], const char* src);
 
 } // namespace wave {
 
+// 解析時に出力した音声PCM(wave)の読み込み
+// --lazy-waveの場合はwaveファイルの代わりにAACフレームのインデックスが書かれていて
+// 要求された範囲を含むフレームをその場でデコードする
+class WaveSource {
+public:
+    virtual ~WaveSource() { }
+    // wave上のoffsetからdst.length分を読む（データがない部分はゼロ埋め）
+    virtual void read(int64_t offset, MemoryChunk dst) = 0;
+};
+
+// waveファイルまたはインデックスを開く
+std::unique_ptr<WaveSource> OpenWaveSource(AMTContext& ctx, const tstring& wavepath);
+
+// waveファイルの代わりにインデックスを書き込む
+// audiopathはframesのfileOffsetが指すAACフレームのファイル
+void WriteWaveIndex(const File& file, const tstring& audiopath,
+    const std::vector<FileAudioFrameInfo>& frames);
+
 void EncodeAudio(AMTContext& ctx, const tstring& encoder_args,
     const tstring& audiopath, const AudioFormat& afmt,
     const std::vector<FilterAudioFrame>& audioFrames);
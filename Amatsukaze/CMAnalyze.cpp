@@ -8,6 +8,7 @@
 
 #include <future>
 #include <cmath>
+#include <sstream>
 #include "CMAnalyze.h"
 
 CMAnalyze::CMAnalyze(AMTContext& ctx,
@@ -15,6 +16,7 @@ CMAnalyze::CMAnalyze(AMTContext& ctx,
     AMTObject(ctx),
     setting_(setting),
     logoAnalysisDone(false),
+    chapterAnalysisDone(false),
     logopath(),
     trims(),
     cmzones(),
@@ -30,12 +32,16 @@ void CMAnalyze::analyze(const int serviceId, const int videoFileIndex, const int
         const bool logoOffJL = logoOffInJL(videoFileIndex);
         if (logoOffJL) {
             ctx.info("チャプター・CM解析にロゴを使用しません。");
-        } else {
+        }
+        if (setting_.isChapterExeBuiltin()) {
+            // ロゴ解析と無音・シーンチェンジ解析を1回のデコードで行う
+            analyzeLogoAndChapter(videoFileIndex, numFrames, !logoOffJL || !setting_.isNoDelogo(), sw, avspath);
+        } else if (!logoOffJL) {
             // JLにLogoOffの記述がない場合は先にロゴ解析を行う
             analyzeLogo(videoFileIndex, numFrames, sw, avspath);
         }
         // チャプター・CM解析本体
-        analyzeChapterCM(serviceId, videoFileIndex, numFrames, sw, avspath);
+        analyzeChapterCM(serviceId, videoFileIndex, numFrames, !logoOffJL, sw, avspath);
     }
 
     // ロゴ解析 (未実行かつロゴ消しする場合)
@@ -51,27 +57,32 @@ void CMAnalyze::analyzeLogo(const int videoFileIndex, const int numFrames, Stopw
         sw.start();
         logoFrame(videoFileIndex, numFrames, avspath);
         ctx.infoF("完了: %.2f秒", sw.getAndReset());
-
-        ctx.info("[ロゴ解析結果]");
-        if (logopath.size() > 0) {
-            ctx.infoF("マッチしたロゴ: %s", logopath.c_str());
-            PrintFileAll(setting_.getTmpLogoFramePath(videoFileIndex));
-        }
-        const auto& eraseLogoPath = setting_.getEraseLogoPath();
-        for (int i = 0; i < (int)eraseLogoPath.size(); ++i) {
-            ctx.infoF("追加ロゴ%d: %s", i + 1, eraseLogoPath[i].c_str());
-            PrintFileAll(setting_.getTmpLogoFramePath(videoFileIndex, i));
-        }
+        printLogoResult(videoFileIndex);
         logoAnalysisDone = true;
     }
 }
 
-void CMAnalyze::analyzeChapterCM(const int serviceId, const int videoFileIndex, const int numFrames, Stopwatch& sw, const tstring& avspath) {
+void CMAnalyze::printLogoResult(const int videoFileIndex) {
+    ctx.info("[ロゴ解析結果]");
+    if (logopath.size() > 0) {
+        ctx.infoF("マッチしたロゴ: %s", logopath.c_str());
+        PrintFileAll(setting_.getTmpLogoFramePath(videoFileIndex));
+    }
+    const auto& eraseLogoPath = setting_.getEraseLogoPath();
+    for (int i = 0; i < (int)eraseLogoPath.size(); ++i) {
+        ctx.infoF("追加ロゴ%d: %s", i + 1, eraseLogoPath[i].c_str());
+        PrintFileAll(setting_.getTmpLogoFramePath(videoFileIndex, i));
+    }
+}
+
+void CMAnalyze::analyzeChapterCM(const int serviceId, const int videoFileIndex, const int numFrames, const bool useLogo, Stopwatch& sw, const tstring& avspath) {
     // チャプター解析
-    ctx.info("[無音・シーンチェンジ解析]");
-    sw.start();
-    chapterExe(videoFileIndex, avspath);
-    ctx.infoF("完了: %.2f秒", sw.getAndReset());
+    if (!chapterAnalysisDone) {
+        ctx.info("[無音・シーンチェンジ解析]");
+        sw.start();
+        chapterExe(videoFileIndex, avspath);
+        ctx.infoF("完了: %.2f秒", sw.getAndReset());
+    }
 
     ctx.info("[無音・シーンチェンジ解析結果]");
     PrintFileAll(setting_.getTmpChapterExeOutPath(videoFileIndex));
@@ -79,7 +90,7 @@ void CMAnalyze::analyzeChapterCM(const int serviceId, const int videoFileIndex,
     // CM推定
     ctx.info("[CM解析]");
     sw.start();
-    joinLogoScp(videoFileIndex, serviceId);
+    joinLogoScp(videoFileIndex, serviceId, useLogo);
     ctx.infoF("完了: %.2f秒", sw.getAndReset());
 
     ctx.info("[CM解析結果 - TrimAVS]");
@@ -222,7 +233,8 @@ tstring CMAnalyze::makeAVSFile(int videoFileIndex) {
     sb.append("ClearAutoloadDirs()\n");
 
     sb.append("LoadPlugin(\"%s\")\n", GetModulePath().c_str());
-    sb.append("AMTSource(\"%s\")\n", setting_.getTmpAMTSourcePath(videoFileIndex).c_str());
+    sb.append("AMTSource(\"%s\", decoders=%d, cachemb=%d)\n",
+        setting_.getTmpAMTSourcePath(videoFileIndex).c_str(), setting_.getNumSourceDecoders(), setting_.getSourceCacheSizeMB());
     sb.append("Prefetch(1)\n");
     tstring avspath = setting_.getTmpSourceAVSPath(videoFileIndex);
     File file(avspath, _T("w"));
@@ -244,7 +256,446 @@ extern int Logoframe(const char* avsfile, MLOGO_DATASET& logodata);
 extern int MultLogo_FileStrGet(char** name_dst, const char* name_src);
 extern void LogoWriteFind(LOGO_DATASET *pl, FILE *fpo_ana);
 
-void CMAnalyze::logoFrame(const int videoFileIndex, const int numFrames, const tstring& avspath) {
+#include <dlfcn.h>
+#include "AMTSource.h"
+
+// MultLogoCalcをフレーム区間（チャンク）・ロゴ単位に分けて複数スレッドで実行する
+// 各ロゴの結果はframedatのフレーム番号の位置にしか書き込まれないので
+// チャンクごとに独立して計算し、全チャンクの完了を待てばMultLogoFindの前にまとまる
+// 作業領域だけスレッドごとに持てばよい
+class MultLogoCalcThreads {
+public:
+    MultLogoCalcThreads(MLOGO_DATASET& logodata, int height, int numThreads)
+        : logodata(logodata)
+        , height(height)
+        , numHeldFrames(0)
+        , numRunning(0)
+        , finished(false) {
+        for (int i = 0; i < LOGONUM_MAX; ++i) {
+            if (logodata.all_logodata[i] != NULL) {
+                logos.push_back(i);
+            }
+        }
+        // 保持するフレームはスレッド数の2倍程度まで
+        maxHeldFrames = numThreads * 2;
+        // 1チャンクのフレーム数はロゴ数までにして、保持フレーム数を増やさずに
+        // スレッド数の2倍程度のタスクがあるようにする
+        chunkFrames = std::max(1, std::min((int)logos.size(), std::min(maxHeldFrames, (int)MAX_CHUNK_FRAMES)));
+        try {
+            for (int i = 0; i < numThreads; ++i) {
+                workers.emplace_back(new Worker(*this));
+            }
+        } catch (...) {
+            stop();
+            throw;
+        }
+    }
+    ~MultLogoCalcThreads() {
+        stop();
+    }
+    // フレームは先頭から順に渡されること
+    // 処理待ちが多いときは空くまで待つ
+    void put(int frm, const PVideoFrame& frame) {
+        if (logos.size() == 0) {
+            return;
+        }
+        if (current && current->start + (int)current->frames.size() != frm) {
+            flush();
+        }
+        if (!current) {
+            current = std::make_shared<Chunk>();
+            current->start = frm;
+            current->numLogosLeft = (int)logos.size();
+        }
+        current->frames.push_back(frame);
+        if ((int)current->frames.size() >= chunkFrames) {
+            flush();
+        }
+    }
+    // 投入した全フレームの処理完了を待つ
+    void finish() {
+        flush();
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            while (tasks.size() > 0 || numRunning > 0) {
+                cond.wait(lock);
+            }
+        }
+        stop();
+    }
+private:
+    enum { MAX_CHUNK_FRAMES = 16 };
+
+    // 連続するフレーム
+    struct Chunk {
+        int start;
+        std::vector<PVideoFrame> frames;
+        int numLogosLeft; // 処理が終わっていないロゴ数
+    };
+
+    struct Task {
+        std::shared_ptr<Chunk> chunk;
+        int logo;
+    };
+
+    class Worker : private ThreadBase {
+    public:
+        Worker(MultLogoCalcThreads& parent) : parent(parent) {
+            // SIMD用作業領域は最大のロゴ幅で一度だけ確保する
+            int maxWidth = 0;
+            for (int logo : parent.logos) {
+                maxWidth = std::max<int>(maxWidth, parent.logodata.all_logodata[logo]->paramdat.yw);
+            }
+            chkopp.resize(maxWidth + 8);
+            start();
+        }
+        ~Worker() {
+            join();
+        }
+    protected:
+        virtual void run() {
+            while (true) {
+                Task task;
+                {
+                    std::unique_lock<std::mutex> lock(parent.mtx);
+                    while (parent.tasks.size() == 0 && !parent.finished) {
+                        parent.cond.wait(lock);
+                    }
+                    if (parent.finished) return;
+                    task = parent.tasks.front();
+                    parent.tasks.pop_front();
+                    ++parent.numRunning;
+                    parent.cond.notify_all();
+                }
+                Chunk& chunk = *task.chunk;
+                for (int i = 0; i < (int)chunk.frames.size(); ++i) {
+                    const PVideoFrame& frame = chunk.frames[i];
+                    MultLogoCalcWork(&parent.logodata, task.logo, &work[0], &work[1], chkopp.data(),
+                        frame->GetReadPtr(PLANAR_Y), frame->GetPitch(PLANAR_Y), chunk.start + i, parent.height);
+                }
+                // 全ロゴ終わったチャンクのフレームはロックの外で解放する
+                std::vector<PVideoFrame> done;
+                {
+                    std::unique_lock<std::mutex> lock(parent.mtx);
+                    if (--chunk.numLogosLeft == 0) {
+                        parent.numHeldFrames -= (int)chunk.frames.size();
+                        done.swap(chunk.frames);
+                    }
+                    --parent.numRunning;
+                    parent.cond.notify_all();
+                }
+            }
+        }
+    private:
+        MultLogoCalcThreads& parent;
+        LOGO_CALCREC work[2];
+        std::vector<uint8_t> chkopp;
+    };
+
+    MLOGO_DATASET& logodata;
+    int height;
+    std::vector<int> logos;
+    int chunkFrames;
+    std::shared_ptr<Chunk> current; // 投入前のチャンク（投入スレッドだけが触る）
+    std::deque<Task> tasks;
+    int maxHeldFrames;
+    int numHeldFrames;
+    int numRunning;
+    bool finished;
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // 投入前のチャンクをロゴ数分のタスクにして投入する
+    void flush() {
+        if (!current) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mtx);
+        // 1チャンクも保持していなければ上限を超えても投入する
+        while (numHeldFrames > 0 && numHeldFrames + (int)current->frames.size() > maxHeldFrames) {
+            cond.wait(lock);
+        }
+        numHeldFrames += (int)current->frames.size();
+        for (int logo : logos) {
+            Task task = { current, logo };
+            tasks.push_back(task);
+        }
+        current = nullptr;
+        cond.notify_all();
+    }
+
+    void stop() {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            finished = true;
+            cond.notify_all();
+        }
+        workers.clear();
+        tasks.clear();
+        current = nullptr;
+    }
+};
+
+SilenceSceneDetector::SilenceSceneDetector(const tstring& chapterExeOptions)
+    : muteThreshold(50)
+    , minMuteFrames(10)
+    , valid(false)
+    , vi() {
+    // しきい値のデフォルトはchapter_exeと同じ
+    std::istringstream is(chapterExeOptions);
+    std::string arg;
+    while (is >> arg) {
+        if (arg == "-m" && (is >> arg)) {
+            muteThreshold = std::atoi(arg.c_str());
+        } else if (arg == "-s" && (is >> arg)) {
+            minMuteFrames = std::atoi(arg.c_str());
+        }
+    }
+}
+
+bool SilenceSceneDetector::init(const VideoInfo& vi_) {
+    if (!vi_.HasAudio() || vi_.sample_type != SAMPLE_INT16) {
+        return false;
+    }
+    vi = vi_;
+    mute.assign(vi.num_frames, 0);
+    diff.assign(vi.num_frames, 0);
+    prevY.clear();
+    zones.clear();
+    valid = false;
+    return true;
+}
+
+// フレームは先頭から順に渡されること
+void SilenceSceneDetector::addFrame(int frm, const PVideoFrame& frame, const int16_t* audio, int numSamples) {
+    int maxAmp = 0;
+    for (int i = 0; i < numSamples; ++i) {
+        maxAmp = std::max(maxAmp, std::abs((int)audio[i]));
+    }
+    mute[frm] = (maxAmp < muteThreshold);
+
+    // 前フレームとの輝度差（縦横4画素ごとに間引く）
+    enum { STEP = 4 };
+    const uint8_t* src = frame->GetReadPtr(PLANAR_Y);
+    const int pitch = frame->GetPitch(PLANAR_Y);
+    const int w = vi.width / STEP;
+    const int h = vi.height / STEP;
+    const bool hasPrev = (frm > 0 && (int)prevY.size() == w * h);
+    prevY.resize(w * h);
+    int64_t sum = 0;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* line = src + y * STEP * pitch;
+        uint8_t* prev = &prevY[y * w];
+        for (int x = 0; x < w; ++x) {
+            uint8_t v = line[x * STEP];
+            sum += std::abs((int)v - (int)prev[x]);
+            prev[x] = v;
+        }
+    }
+    diff[frm] = hasPrev ? sum : 0;
+}
+
+void SilenceSceneDetector::finish() {
+    const int n = (int)mute.size();
+    zones.clear();
+    for (int i = 0; i < n;) {
+        if (mute[i] == 0) {
+            ++i;
+            continue;
+        }
+        int j = i;
+        while (j < n && mute[j]) ++j;
+        if (j - i >= minMuteFrames) {
+            // 無音区間と直後のフレームで前フレームとの差が最も大きい位置
+            // （chapter_exeのシーンチェンジ判定の近似）
+            MuteZone zone = { i, j, i };
+            for (int k = i; k <= std::min(j, n - 1); ++k) {
+                if (diff[k] > diff[zone.scPos]) {
+                    zone.scPos = k;
+                }
+            }
+            zones.push_back(zone);
+        }
+        i = j;
+    }
+    valid = true;
+}
+
+void SilenceSceneDetector::writeLog(const tstring& path) const {
+    StringBuilder sb;
+    sb.append("chapter_exe (Amatsukaze内蔵の近似)\n");
+    sb.append("mute threshold: %d, seri: %d\n", muteThreshold, minMuteFrames);
+    sb.append("-------\n");
+    for (int i = 0; i < (int)zones.size(); ++i) {
+        const auto& zone = zones[i];
+        sb.append("mute%2d: %d - %dフレーム\n", i + 1, zone.start, zone.end - 1);
+        sb.append(" SCPos: %d %d\n", zone.scPos, zone.scPos - 1);
+    }
+    File file(path, _T("w"));
+    file.write(sb.getMC());
+}
+
+void SilenceSceneDetector::writeChapter(const tstring& path) const {
+    StringBuilder sb;
+    for (int i = 0; i < (int)zones.size(); ++i) {
+        const auto& zone = zones[i];
+        sb.append("Chapter%02d=%s\n", i + 1, frameToTime(zone.start).c_str());
+        sb.append("Chapter%02dName=%dフレーム SCPos:%d %d\n", i + 1, zone.end - zone.start, zone.scPos, zone.scPos - 1);
+    }
+    File file(path, _T("w"));
+    file.write(sb.getMC());
+}
+
+std::string SilenceSceneDetector::frameToTime(int frm) const {
+    int64_t ms = (int64_t)frm * 1000 * vi.fps_denominator / vi.fps_numerator;
+    return StringFormat("%02d:%02d:%02d.%03d",
+        (int)(ms / 3600000), (int)(ms / 60000 % 60), (int)(ms / 1000 % 60), (int)(ms % 1000));
+}
+
+// 解析パスでデコードしたフレームを受け取る
+class AnalyzeFrameSink {
+public:
+    virtual ~AnalyzeFrameSink() {}
+    virtual void onFrame(int frm, const PVideoFrame& frame) = 0;
+    virtual void onEnd() = 0;
+};
+
+// MultLogoCalcはロゴ領域の行しか読まないのでYプレーンをコピーせずにそのまま渡す
+class LogoCalcSink : public AnalyzeFrameSink {
+public:
+    LogoCalcSink(MLOGO_DATASET& logodata, int height, int numThreads)
+        : logodata(logodata)
+        , height(height) {
+        // デバッグ用毎フレーム情報はフレーム順に出力する必要があるので並列化しない
+        for (int i = 0; i < LOGONUM_MAX; ++i) {
+            if (logodata.fpo_ana2[i] != NULL) {
+                numThreads = 1;
+            }
+        }
+        if (numThreads > 1) {
+            calcThreads = std::unique_ptr<MultLogoCalcThreads>(
+                new MultLogoCalcThreads(logodata, height, numThreads));
+        }
+    }
+    virtual void onFrame(int frm, const PVideoFrame& frame) {
+        if (calcThreads) {
+            calcThreads->put(frm, frame);
+        } else {
+            MultLogoCalc(&logodata, frame->GetReadPtr(PLANAR_Y), frame->GetPitch(PLANAR_Y), frm, height);
+        }
+    }
+    virtual void onEnd() {
+        if (calcThreads) {
+            calcThreads->finish();
+        }
+        MultLogoFind(&logodata);
+    }
+private:
+    MLOGO_DATASET& logodata;
+    int height;
+    std::unique_ptr<MultLogoCalcThreads> calcThreads;
+};
+
+class SilenceSceneSink : public AnalyzeFrameSink {
+public:
+    SilenceSceneSink(SilenceSceneDetector& scdet, PClip clip, IScriptEnvironment* env)
+        : scdet(scdet)
+        , clip(clip)
+        , env(env)
+        , vi(clip->GetVideoInfo()) {}
+    virtual void onFrame(int frm, const PVideoFrame& frame) {
+        int64_t start = vi.AudioSamplesFromFrames(frm);
+        int64_t end = std::min(vi.AudioSamplesFromFrames(frm + 1), vi.num_audio_samples);
+        int numSamples = (int)std::max<int64_t>(0, end - start);
+        audio.resize(numSamples * vi.nchannels);
+        if (numSamples > 0) {
+            clip->GetAudio(audio.data(), start, numSamples, env);
+        }
+        scdet.addFrame(frm, frame, audio.data(), numSamples * vi.nchannels);
+    }
+    virtual void onEnd() {
+        scdet.finish();
+    }
+private:
+    SilenceSceneDetector& scdet;
+    PClip clip;
+    IScriptEnvironment* env;
+    VideoInfo vi;
+    std::vector<int16_t> audio;
+};
+
+// AviSynthスクリプトを介さずにAMTSourceから直接フレームを取得して
+// ロゴ解析と無音・シーンチェンジ解析を1回のデコードで行う
+// logodata: nullptrならロゴ解析しない
+// scdet: nullptrなら無音・シーンチェンジ解析しない（音声がない場合もしない）
+// 8bit YUV以外は変換が必要なのでfalseを返す（logodata,scdetは変更しない）
+static bool AnalyzeNative(AMTContext& ctx, const tstring& amtspath,
+    MLOGO_DATASET* logodata, int numThreads, SilenceSceneDetector* scdet, int numDecoders, int cacheMB) {
+    void *handle = dlopen("libavisynth.so", RTLD_LAZY);
+    if (handle == NULL) {
+        THROW(RuntimeException, "Cannot load libavisynth.so");
+    }
+    typedef IScriptEnvironment2 * (* func_t)(int);
+    func_t CreateScriptEnvironment2 = (func_t)dlsym(handle, "CreateScriptEnvironment2");
+    if (CreateScriptEnvironment2 == NULL) {
+        THROW(RuntimeException, "Cannot find CreateScriptEnvironment2");
+    }
+    auto env = make_unique_ptr(CreateScriptEnvironment2(AVISYNTH_INTERFACE_VERSION));
+    if (AVS_linkage == nullptr) {
+        AVS_linkage = env->GetAVSLinkage();
+    }
+    try {
+        // QPテーブルは不要
+        PClip clip = av::LoadAMTSource(ctx, amtspath, "", false, 0, 8, numDecoders, cacheMB, env.get());
+        const VideoInfo vi = clip->GetVideoInfo();
+        if (!vi.IsPlanar() || !vi.IsYUV() || vi.BitsPerComponent() != 8) {
+            return false;
+        }
+
+        std::vector<std::unique_ptr<AnalyzeFrameSink>> sinks;
+        if (logodata != nullptr) {
+            MultLogoOptionOrgFile(logodata);
+            int errnum = MultLogoSetup(logodata, vi.num_frames);
+            if (errnum == 3) {
+                // ロゴ定義がない
+                logodata = nullptr;
+            } else if (errnum != 0) {
+                THROWF(RuntimeException, "ロゴ解析の初期化に失敗 (%d)", errnum);
+            }
+        }
+        if (logodata != nullptr) {
+            if (logodata->dispoff == 0 && logodata->paramoff == 0) {
+                MultLogoDisplayParam(logodata);
+            }
+            sinks.emplace_back(new LogoCalcSink(*logodata, vi.height, numThreads));
+        }
+        if (scdet != nullptr && scdet->init(vi)) {
+            sinks.emplace_back(new SilenceSceneSink(*scdet, clip, env.get()));
+        }
+
+        if (sinks.size() > 0) {
+            for (int frm = 0; frm < vi.num_frames; ++frm) {
+                PVideoFrame frame = clip->GetFrame(frm, env.get());
+                for (auto& sink : sinks) {
+                    sink->onFrame(frm, frame);
+                }
+            }
+            for (auto& sink : sinks) {
+                sink->onEnd();
+            }
+        }
+    } catch (const AvisynthError& err) {
+        THROWF(AviSynthException, "%s", err.msg);
+    }
+    return true;
+}
+
+bool AnalyzeSilenceScene(AMTContext& ctx, const tstring& amtspath, SilenceSceneDetector& scdet, int numDecoders, int cacheMB) {
+    return AnalyzeNative(ctx, amtspath, nullptr, 1, &scdet, numDecoders, cacheMB) && scdet.isValid();
+}
+
+void CMAnalyze::logoFrame(const int videoFileIndex, const int numFrames, const tstring& avspath, SilenceSceneDetector* scdet) {
     const auto& logoPath = setting_.getLogoPath();
     const auto& eraseLogoPath = setting_.getEraseLogoPath();
     std::vector<tstring> allLogoPath = logoPath;
@@ -256,7 +707,17 @@ void CMAnalyze::logoFrame(const int videoFileIndex, const int numFrames, const t
         MultLogo_FileStrGet(&(logodata.all_logofilename[i]), allLogoPath[i].c_str());
     }
     
-    int ret = Logoframe(avspath.c_str(), logodata); 
+    int ret = 0;
+    try {
+        if (!AnalyzeNative(ctx, setting_.getTmpAMTSourcePath(videoFileIndex), &logodata,
+            setting_.isParallelLogoAnalysis() ? GetProcessorCount() : 1, scdet, setting_.getNumSourceDecoders(), setting_.getSourceCacheSizeMB())) {
+            ctx.info("8bit YUVでないためAviSynthスクリプト経由でロゴ解析します");
+            ret = Logoframe(avspath.c_str(), logodata);
+        }
+    } catch (const Exception&) {
+        MultLogoFree(&logodata);
+        throw;
+    }
     if (ret != 0) {
         MultLogoFree(&logodata);
         THROWF(RuntimeException, "ロゴ解析に失敗\n");
@@ -321,6 +782,33 @@ void CMAnalyze::logoFrame(const int videoFileIndex, const int numFrames, const t
     logoFrameCmd = sb.str();
 }
 
+void CMAnalyze::analyzeLogoAndChapter(const int videoFileIndex, const int numFrames, const bool withLogo, Stopwatch& sw, const tstring& avspath) {
+    const bool logo = withLogo && !logoAnalysisDone
+        && (setting_.getLogoPath().size() > 0 || setting_.getEraseLogoPath().size() > 0);
+    SilenceSceneDetector scdet(setting_.getChapterExeOptions());
+    ctx.info(logo ? "[ロゴ・無音・シーンチェンジ解析]" : "[無音・シーンチェンジ解析]");
+    sw.start();
+    // 8bit YUVでない場合や音声がない場合はscdetが無効のまま
+    if (logo) {
+        logoFrame(videoFileIndex, numFrames, avspath, &scdet);
+    } else {
+        AnalyzeNative(ctx, setting_.getTmpAMTSourcePath(videoFileIndex), nullptr, 1, &scdet, setting_.getNumSourceDecoders(), setting_.getSourceCacheSizeMB());
+    }
+    if (scdet.isValid()) {
+        scdet.writeLog(setting_.getTmpChapterExeOutPath(videoFileIndex));
+        scdet.writeChapter(setting_.getTmpChapterExePath(videoFileIndex));
+        chapterAnalysisDone = true;
+    }
+    ctx.infoF("完了: %.2f秒", sw.getAndReset());
+    if (logo) {
+        printLogoResult(videoFileIndex);
+        logoAnalysisDone = true;
+    }
+    if (!chapterAnalysisDone) {
+        ctx.info("内蔵の無音・シーンチェンジ解析ができないためchapter_exeを使用します");
+    }
+}
+
 tstring CMAnalyze::MakeChapterExeArgs(int videoFileIndex, const tstring& avspath) {
     return StringFormat(_T("%s -v %s -o %s %s"),
         setting_.getChapterExePath().c_str(), pathToOS(avspath).c_str(),
@@ -339,10 +827,11 @@ void CMAnalyze::chapterExe(int videoFileIndex, const tstring& avspath) {
     }
 }
 
-tstring CMAnalyze::MakeJoinLogoScpArgs(int videoFileIndex) {
+tstring CMAnalyze::MakeJoinLogoScpArgs(int videoFileIndex, bool useLogo) {
     StringBuilderT sb;
     sb.append(_T("%s"), setting_.getJoinLogoScpPath().c_str());
-    if (logopath.size() > 0) {
+    // 内蔵解析ではロゴ消し用にCM解析前にロゴ解析することがあるのでlogopathだけでは判断しない
+    if (useLogo && logopath.size() > 0) {
         sb.append(_T(" -inlogo %s"), pathToOS(setting_.getTmpLogoFramePath(videoFileIndex)).c_str());
     }
     sb.append(_T(" -inscp %s -incmd %s -o %s -oscp %s -odiv %s %s"),
@@ -355,8 +844,8 @@ tstring CMAnalyze::MakeJoinLogoScpArgs(int videoFileIndex) {
     return sb.str();
 }
 
-void CMAnalyze::joinLogoScp(int videoFileIndex, int serviceId) {
-    auto args = MakeJoinLogoScpArgs(videoFileIndex);
+void CMAnalyze::joinLogoScp(int videoFileIndex, int serviceId, bool useLogo) {
+    auto args = MakeJoinLogoScpArgs(videoFileIndex, useLogo);
     ctx.infoF("%s", args.c_str());
     // join_logo_scp向けの環境変数を設定
     const tstring clioutpath = setting_.getOutFileBaseWithoutPrefix() + _T(".") + setting_.getOutputExtention(setting_.getFormat());
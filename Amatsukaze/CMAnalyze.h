@@ -38,6 +38,50 @@ public:
     }
 };
 
+// chapter_exeߎEV[`FWo
+// ̍őUl̃t[萔Ԃ𖳉ԂƂ
+// ԓőOt[Ƃ̋Pxł傫t[V[`FWʒuƂ
+// Px͏c4fƂɊԈ̍vŁAchapter_exẽV[`FWƂ
+// ʕȂ̂ŃV[`FWʒuchapter_exeƈvȂƂ
+// o͂chapter_exeƓ`
+class SilenceSceneDetector {
+public:
+    // chapter_exẽIvVi-m,-sj炵l擾
+    SilenceSceneDetector(const tstring& chapterExeOptions);
+
+    // Ȃꍇfalse
+    bool init(const VideoInfo& vi);
+    // frame8bit YUVł邱
+    void addFrame(int frm, const PVideoFrame& frame, const int16_t* audio, int numSamples);
+    void finish();
+
+    bool isValid() const { return valid; }
+    // chapter_exe̕Wo͂Ɠ`
+    void writeLog(const tstring& path) const;
+    // chapter_exe-oƓ`
+    void writeChapter(const tstring& path) const;
+
+private:
+    struct MuteZone {
+        int start, end; // [start,end)
+        int scPos;
+    };
+    int muteThreshold;
+    int minMuteFrames;
+    bool valid;
+    VideoInfo vi;
+    std::vector<uint8_t> mute;
+    std::vector<int64_t> diff;
+    std::vector<uint8_t> prevY;
+    std::vector<MuteZone> zones;
+
+    std::string frameToTime(int frm) const;
+};
+
+// AMTSource̒ԃt@CfR[hscdetŉ͂
+// 8bit YUVłȂꍇ≹Ȃꍇfalse
+bool AnalyzeSilenceScene(AMTContext& ctx, const tstring& amtspath, SilenceSceneDetector& scdet, int numDecoders, int cacheMB);
+
 class CMAnalyze : public AMTObject {
 public:
     CMAnalyze(AMTContext& ctx,
@@ -49,6 +93,7 @@ public:
     const std::vector<int>& getTrims() const { return trims; }
     const std::vector<EncoderZone>& getZones() const { return cmzones; }
     const std::vector<int>& getDivs() const { return divs; }
+    const std::vector<int>& getSceneChanges() const { return sceneChanges; }
     const std::string& getLogoFrameCmd() const { return logoFrameCmd; }
 
     // PMTύX񂩂CMǉF
@@ -71,6 +116,7 @@ private:
     const ConfigWrapper& setting_;
 
     bool logoAnalysisDone;
+    bool chapterAnalysisDone;
     tstring logopath;
     std::vector<int> trims;
     std::vector<EncoderZone> cmzones;
@@ -80,21 +126,26 @@ private:
 
     void analyzeLogo(const int videoFileIndex, const int numFrames, Stopwatch& sw, const tstring& avspath);
 
-    void analyzeChapterCM(const int serviceId, const int videoFileIndex, const int numFrames, Stopwatch& sw, const tstring& avspath);
+    void analyzeLogoAndChapter(const int videoFileIndex, const int numFrames, const bool withLogo, Stopwatch& sw, const tstring& avspath);
+
+    void printLogoResult(const int videoFileIndex);
+
+    // useLogo: JLLogoOff̋LqȂtrueifalseȂ烍S͍ς݂łjoin_logo_scpɃSnȂj
+    void analyzeChapterCM(const int serviceId, const int videoFileIndex, const int numFrames, const bool useLogo, Stopwatch& sw, const tstring& avspath);
 
     tstring makeAVSFile(int videoFileIndex);
 
     void makePreamble(IScriptEnvironment2* env);
 
-    void logoFrame(const int videoFileIndex, const int numFrames, const tstring& avspath);
+    void logoFrame(const int videoFileIndex, const int numFrames, const tstring& avspath, SilenceSceneDetector* scdet = nullptr);
 
     tstring MakeChapterExeArgs(int videoFileIndex, const tstring& avspath);
 
     void chapterExe(int videoFileIndex, const tstring& avspath);
 
-    tstring MakeJoinLogoScpArgs(int videoFileIndex);
+    tstring MakeJoinLogoScpArgs(int videoFileIndex, bool useLogo);
 
-    void joinLogoScp(int videoFileIndex, int serviceId);
+    void joinLogoScp(int videoFileIndex, int serviceId, bool useLogo);
 
     void readTrimAVS(int videoFileIndex, int numFrames);
 
@@ -9,6 +9,8 @@
 // このファイルはAVXでコンパイル
 #include <immintrin.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
 
 struct CPUInfo {
     bool initialized, avx, avx2;
@@ -78,7 +80,8 @@ static inline void InitCPUInfo() {
             unsigned long long xcrFeatureMask = _xgetbv(0);
             g_cpuinfo.avx = (xcrFeatureMask & 0x6) == 0x6;
             if (g_cpuinfo.avx) {
-                g_cpuinfo.avx2 = f1.ebx >> 5 & 1;
+                CpuInfo f7(7, 0);
+                g_cpuinfo.avx2 = f7.ebx >> 5 & 1;
             }
         }
         g_cpuinfo.initialized = true;
@@ -231,3 +234,476 @@ void removeLogoLineAVX2(float *dst, const float *src, const int srcStride, const
         _mm_store_ss(dst + x, dstv);
     }
 }
+
+// TSパケットの同期バイト検索 //
+
+enum {
+    SYNC_PACKET_LENGTH = 188,
+    SYNC_BYTE = 0x47,
+};
+
+static inline int CountTrailingZeros(uint32_t v) {
+#ifdef _WIN32
+    unsigned long index;
+    _BitScanForward(&index, v);
+    return (int)index;
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
+// ptrから188バイト間隔で同期バイトが連続して合っている数を返す（最大numPackets）
+// 8パケット分の先頭をgatherでまとめて比較する
+int CountSyncBytesAVX2(const uint8_t* ptr, int numPackets) {
+    const __m256i vindex = _mm256_setr_epi32(
+        SYNC_PACKET_LENGTH * 0, SYNC_PACKET_LENGTH * 1, SYNC_PACKET_LENGTH * 2, SYNC_PACKET_LENGTH * 3,
+        SYNC_PACKET_LENGTH * 4, SYNC_PACKET_LENGTH * 5, SYNC_PACKET_LENGTH * 6, SYNC_PACKET_LENGTH * 7);
+    const __m256i vmask = _mm256_set1_epi32(0xFF);
+    const __m256i vsync = _mm256_set1_epi32(SYNC_BYTE);
+    int i = 0;
+    for (; i + 8 <= numPackets; i += 8) {
+        // 各パケット先頭から4バイト読むのでパケット内に収まる
+        const __m256i v = _mm256_i32gather_epi32((const int*)(ptr + i * SYNC_PACKET_LENGTH), vindex, 1);
+        const __m256i eq = _mm256_cmpeq_epi32(_mm256_and_si256(v, vmask), vsync);
+        const uint32_t bits = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(eq));
+        if (bits != 0xFF) {
+            return i + CountTrailingZeros(~bits);
+        }
+    }
+    for (; i < numPackets; ++i) {
+        if (ptr[i * SYNC_PACKET_LENGTH] != SYNC_BYTE) break;
+    }
+    return i;
+}
+
+// lengthバイトの範囲で188バイト間隔にnumPackets個の同期バイトが並ぶ最初の位置を返す
+// 見つからない場合は length - numPackets * 188 + 1（候補位置を全て調べた）を返す
+// 32個の候補位置をまとめて比較する
+int FindSyncOffsetAVX2(const uint8_t* ptr, int length, int numPackets) {
+    const int last = length - numPackets * SYNC_PACKET_LENGTH;
+    const __m256i vsync = _mm256_set1_epi8(SYNC_BYTE);
+    int offset = 0;
+    for (; offset + 31 <= last; offset += 32) {
+        __m256i m = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(ptr + offset)), vsync);
+        for (int k = 1; k < numPackets; ++k) {
+            const __m256i v = _mm256_loadu_si256((const __m256i*)(ptr + offset + k * SYNC_PACKET_LENGTH));
+            m = _mm256_and_si256(m, _mm256_cmpeq_epi8(v, vsync));
+        }
+        const uint32_t bits = (uint32_t)_mm256_movemask_epi8(m);
+        if (bits != 0) {
+            return offset + CountTrailingZeros(bits);
+        }
+    }
+    for (; offset <= last; ++offset) {
+        int k = 0;
+        for (; k < numPackets; ++k) {
+            if (ptr[offset + k * SYNC_PACKET_LENGTH] != SYNC_BYTE) break;
+        }
+        if (k == numPackets) {
+            return offset;
+        }
+    }
+    return std::max(0, last + 1);
+}
+
+// ---- ロゴ解析 ----
+
+typedef unsigned char BYTE;
+#include "Logoframe.h"
+
+static inline int CountBits8(uint32_t v) {
+#ifdef _WIN32
+    return (int)__popcnt(v);
+#else
+    return __builtin_popcount(v);
+#endif
+}
+
+static inline int MaskBits(__m256i m) {
+    return _mm256_movemask_ps(_mm256_castsi256_ps(m));
+}
+
+static inline __m256i CmpGe(__m256i a, __m256i b) {
+    return _mm256_xor_si256(_mm256_cmpgt_epi32(b, a), _mm256_set1_epi32(-1));
+}
+
+static inline __m256i And3(__m256i a, __m256i b, __m256i c) {
+    return _mm256_and_si256(_mm256_and_si256(a, b), c);
+}
+
+static inline int64_t HSum256(__m256i v) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+// 0方向に切り捨てる v/2
+static inline __m256i HalfTrunc(__m256i v) {
+    return _mm256_srai_epi32(_mm256_add_epi32(v, _mm256_srli_epi32(v, 31)), 1);
+}
+
+// ロゴ解析（Logoframe_det.c）のLogoCalc_getdif_pix(exe_type=0)を8画素ずつ計算する
+// 分岐は全て比較マスクにして、各カウンタにはマスクのビット数を足す
+// 整数除算はdouble(float)で割って切り捨てる（この値域なら整数除算と結果が一致する）
+// difが0の画素は計算しない
+// 反対側の確認が必要な画素はchkoppを1にする（呼び出し側でスカラー版を呼ぶ）
+// 8の倍数分まで処理して処理した画素数を返す
+int LogoCalcDifAVX2(LOGO_CALCREC* plogoc,
+    const uint8_t* data0, const uint8_t* data1, const char* dif,
+    const short* dp_y0, const short* y0, const short* dp_y1, const short* y1,
+    int num, short thres_ymax, short thres_yedge, short thres_ydif, short thres_yoffedg,
+    short most_logo_y, uint8_t* chkopp) {
+    const int thres_dpysmin = 100;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i vmaxdp = _mm256_set1_epi32(LOGO_MAX_DP);
+    const __m256d vmaxdpd = _mm256_set1_pd(LOGO_MAX_DP);
+    const __m256i vhalfdp = _mm256_set1_epi32(LOGO_MAX_DP / 2);
+    const __m256i vmaxy = _mm256_set1_epi32(255 << 4);
+    const __m256i vymax = _mm256_set1_epi32(thres_ymax);
+    const __m256i vymaxf = _mm256_set1_epi32(thres_ymax << 4);
+    const __m256i vyedge = _mm256_set1_epi32(thres_yedge);
+    const __m256i vydif = _mm256_set1_epi32(thres_ydif);
+    const __m256i vyoffedg = _mm256_set1_epi32(thres_yoffedg);
+    const __m256i vmost = _mm256_set1_epi32(most_logo_y);
+    const __m256i vdpysmin = _mm256_set1_epi32(thres_dpysmin);
+    const __m256i vstep = _mm256_set1_epi32((int)plogoc->fade_calcstep);
+    const __m256i v1 = _mm256_set1_epi32(1);
+    const __m256i v2 = _mm256_set1_epi32(2);
+    const __m256i v3 = _mm256_set1_epi32(3);
+    const __m256i v4 = _mm256_set1_epi32(4);
+    const __m256i v5 = _mm256_set1_epi32(5);
+    const __m256i v6 = _mm256_set1_epi32(6);
+    const __m256i v8 = _mm256_set1_epi32(8);
+    const __m256i v10 = _mm256_set1_epi32(10);
+    const __m256i v14 = _mm256_set1_epi32(14);
+    const __m256i v16 = _mm256_set1_epi32(1 << 4);
+    const __m256i v32 = _mm256_set1_epi32(32);
+    const __m256i v48 = _mm256_set1_epi32(3 << 4);
+    const __m256i v56 = _mm256_set1_epi32(56);
+
+    int64_t cnt_logooff = 0, cnt_logoon = 0, cnt_logomv = 0, cnt_offedg = 0;
+    int64_t cntf_logooff = 0, cntf_logoon = 0, cntf_logost = 0, cntf_offedg = 0;
+    int64_t cnts_logooff = 0, cnts_logoon = 0, sum_areanum = 0;
+    int64_t sum_areaoff = 0, sum_areaon = 0, sum_areadif = 0;
+
+    int i = 0;
+    for (; i + 8 <= num; i += 8) {
+        *(uint64_t*)(chkopp + i) = 0;
+        const __m256i active = _mm256_cmpgt_epi32(_mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(dif + i))), zero);
+        if (MaskBits(active) == 0) continue;
+
+        const __m256i p0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(data0 + i)));
+        const __m256i p1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(data1 + i)));
+        const __m256i dp0 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(dp_y0 + i)));
+        const __m256i ly0 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(y0 + i)));
+        const __m256i dp1 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(dp_y1 + i)));
+        const __m256i ly1 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(y1 + i)));
+
+        // d0_rev = ConvInvLogo(d0_s, dp_y0, y0)
+        const __m256i d0_src = _mm256_slli_epi32(p0, 4);
+        const __m256i rdp0 = _mm256_sub_epi32(vmaxdp, dp0);
+        const __m256i num0 = _mm256_add_epi32(
+            _mm256_sub_epi32(_mm256_mullo_epi32(d0_src, vmaxdp), _mm256_mullo_epi32(ly0, dp0)), HalfTrunc(rdp0));
+        const __m128i r0lo = _mm256_cvttpd_epi32(_mm256_div_pd(
+            _mm256_cvtepi32_pd(_mm256_castsi256_si128(num0)), _mm256_cvtepi32_pd(_mm256_castsi256_si128(rdp0))));
+        const __m128i r0hi = _mm256_cvttpd_epi32(_mm256_div_pd(
+            _mm256_cvtepi32_pd(_mm256_extracti128_si256(num0, 1)), _mm256_cvtepi32_pd(_mm256_extracti128_si256(rdp0, 1))));
+        // d1_rev = ConvLogo(d0_rev, dp_y1, y1)
+        // d0_rev * (LOGO_MAX_DP - dp_y1) は32bitに収まらないのでdoubleで計算
+        const __m256i rdp1 = _mm256_sub_epi32(vmaxdp, dp1);
+        const __m256i add1 = _mm256_add_epi32(_mm256_mullo_epi32(ly1, dp1), vhalfdp);
+        const __m128i r1lo = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_add_pd(
+            _mm256_mul_pd(_mm256_cvtepi32_pd(r0lo), _mm256_cvtepi32_pd(_mm256_castsi256_si128(rdp1))),
+            _mm256_cvtepi32_pd(_mm256_castsi256_si128(add1))), vmaxdpd));
+        const __m128i r1hi = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_add_pd(
+            _mm256_mul_pd(_mm256_cvtepi32_pd(r0hi), _mm256_cvtepi32_pd(_mm256_extracti128_si256(rdp1, 1))),
+            _mm256_cvtepi32_pd(_mm256_extracti128_si256(add1, 1))), vmaxdpd));
+        const __m256i d0_rev = _mm256_min_epi32(_mm256_max_epi32(_mm256_set_m128i(r0hi, r0lo), zero), vmaxy);
+        const __m256i d1_rev = _mm256_min_epi32(_mm256_max_epi32(_mm256_set_m128i(r1hi, r1lo), zero), vmaxy);
+
+        const __m256i d1 = _mm256_min_epi32(p1, vymax);
+        const __m256i d1s = _mm256_min_epi32(p0, vymax);
+        const __m256i d1r = _mm256_min_epi32(_mm256_srai_epi32(_mm256_add_epi32(d1_rev, v8), 4), vymax);
+
+        const __m256i oppside = _mm256_or_si256(
+            _mm256_and_si256(_mm256_cmpgt_epi32(d1s, d1), _mm256_cmpgt_epi32(d1r, d1s)),
+            _mm256_and_si256(_mm256_cmpgt_epi32(d1, d1s), _mm256_cmpgt_epi32(d1s, d1r)));
+        const __m256i val_offedg = _mm256_or_si256(_mm256_cmpgt_epi32(p0, vyoffedg), _mm256_cmpgt_epi32(p1, vyoffedg));
+        const __m256i d1dif_fine = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_min_epi32(d1_rev, vymaxf), _mm256_slli_epi32(d1s, 4)));
+
+        const __m256i d0calc_adif = _mm256_abs_epi32(_mm256_sub_epi32(d0_src, d0_rev));
+        const __m256i d1calc_adif = _mm256_abs_epi32(_mm256_sub_epi32(d0_rev, d1_rev));
+        const __m256i d0a16 = CmpGe(d0calc_adif, v16);
+        const __m256i d1a16 = CmpGe(d1calc_adif, v16);
+        const __m256i d0calc_much = _mm256_and_si256(CmpGe(_mm256_slli_epi32(d0calc_adif, 1), d1calc_adif), d0a16);
+        const __m256i d1calc_much = _mm256_and_si256(CmpGe(_mm256_slli_epi32(d1calc_adif, 1), d0calc_adif), d1a16);
+        const __m256i most_adif_y0 = _mm256_abs_epi32(_mm256_sub_epi32(vmost, _mm256_srai_epi32(_mm256_add_epi32(ly0, v8), 4)));
+        const __m256i most_adif_y1 = _mm256_abs_epi32(_mm256_sub_epi32(vmost, _mm256_srai_epi32(_mm256_add_epi32(ly1, v8), 4)));
+        const __m256i m0g2 = _mm256_cmpgt_epi32(most_adif_y0, v2);
+        const __m256i m1g2 = _mm256_cmpgt_epi32(most_adif_y1, v2);
+        const __m256i m0g32 = _mm256_cmpgt_epi32(most_adif_y0, v32);
+        const __m256i m1g32 = _mm256_cmpgt_epi32(most_adif_y1, v32);
+        const __m256i small0 = _mm256_cmpgt_epi32(vdpysmin, dp0);
+        const __m256i small1 = _mm256_cmpgt_epi32(vdpysmin, dp1);
+
+        const __m256i d1dif = _mm256_sub_epi32(d1r, d1s);
+        const __m256i ad = _mm256_abs_epi32(d1dif);
+        const __m256i ad14 = _mm256_cmpgt_epi32(v14, ad);
+        const __m256i as = _mm256_abs_epi32(_mm256_sub_epi32(d1, d1s));
+        const __m256i ar = _mm256_abs_epi32(_mm256_sub_epi32(d1, d1r));
+
+        // 判定は上から順に最初に当てはまったものだけ
+        __m256i rem = active;
+        __m256i opp = zero;
+        __m256i b;
+        // 明るすぎる
+        b = And3(rem, _mm256_and_si256(_mm256_cmpgt_epi32(p0, vymax), _mm256_cmpgt_epi32(p1, vymax)),
+            CmpGe(d1r, _mm256_sub_epi32(vymax, v1)));
+        rem = _mm256_andnot_si256(b, rem);
+        b = And3(rem, _mm256_and_si256(_mm256_cmpgt_epi32(p0, vyedge), _mm256_cmpgt_epi32(p1, vyedge)),
+            _mm256_cmpgt_epi32(d1r, _mm256_sub_epi32(vyedge, v10)));
+        rem = _mm256_andnot_si256(b, rem);
+        b = And3(rem, _mm256_cmpgt_epi32(v10, ad),
+            _mm256_or_si256(_mm256_and_si256(d0a16, m0g2), _mm256_and_si256(d1a16, m1g2)));
+        rem = _mm256_andnot_si256(b, rem);
+        b = And3(rem, ad14,
+            _mm256_or_si256(And3(small0, d0calc_much, m0g2), And3(small1, d1calc_much, m1g2)));
+        rem = _mm256_andnot_si256(b, rem);
+        b = _mm256_and_si256(rem, _mm256_or_si256(
+            And3(_mm256_or_si256(ad14, small0), d0calc_much, m0g32),
+            And3(_mm256_or_si256(ad14, small1), d1calc_much, m1g32)));
+        if (thres_yoffedg >= 255) {
+            const __m256i off = _mm256_and_si256(b, _mm256_cmpgt_epi32(v4, as));
+            cnts_logooff += CountBits8(MaskBits(off));
+            cnts_logoon += CountBits8(MaskBits(And3(_mm256_andnot_si256(off, b), _mm256_cmpgt_epi32(v5, ar), b)));
+        }
+        rem = _mm256_andnot_si256(b, rem);
+        if (thres_yoffedg < 255) {
+            b = And3(rem, _mm256_cmpgt_epi32(v4, as), _mm256_or_si256(
+                And3(small0, d0a16, m0g32), And3(small1, d0a16, m1g32)));
+            rem = _mm256_andnot_si256(b, rem);
+        }
+
+        // 大振幅
+        b = _mm256_and_si256(rem, CmpGe(ad, v10));
+        rem = _mm256_andnot_si256(b, rem);
+        const int bitsd = MaskBits(b);
+        if (bitsd) {
+            // フェード用ヒストグラム
+            const __m256i numer = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(d1, d1s), vstep), HalfTrunc(d1dif));
+            const __m256i val = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(numer), _mm256_cvtepi32_ps(d1dif)));
+            alignas(32) int vals[8];
+            _mm256_store_si256((__m256i*)vals, val);
+            for (int k = 0; k < 8; ++k) {
+                if (bitsd & (1 << k)) {
+                    int v = vals[k] + LOGO_FADE_OFST;
+                    if (v >= 0 && v < LOGO_FADE_MAXLEVEL) {
+                        plogoc->hist_y[v] += 1;
+                    }
+                }
+            }
+            const __m256i off = _mm256_and_si256(b, _mm256_cmpgt_epi32(v4, as));
+            const __m256i on = And3(_mm256_andnot_si256(off, b), _mm256_cmpgt_epi32(v5, ar), b);
+            const __m256i mv = _mm256_andnot_si256(_mm256_or_si256(off, on), b);
+            cnt_logooff += CountBits8(MaskBits(off));
+            cnt_offedg += CountBits8(MaskBits(_mm256_and_si256(off, val_offedg)));
+            cnt_logoon += CountBits8(MaskBits(on));
+            cnt_logomv += CountBits8(MaskBits(mv));
+            opp = _mm256_or_si256(opp, _mm256_and_si256(mv, oppside));
+        }
+
+        // 小振幅
+        b = rem;
+        if (MaskBits(b)) {
+            __m256i off, on, other;
+            __m256i offAll = zero, onAll = zero, oppAll = zero;
+            // abs(d1dif) >= 6
+            __m256i c = _mm256_and_si256(b, CmpGe(ad, v6));
+            __m256i r = _mm256_andnot_si256(c, b);
+            off = _mm256_and_si256(c, _mm256_cmpgt_epi32(v3, as));
+            on = And3(_mm256_andnot_si256(off, c), _mm256_cmpgt_epi32(v3, ar), c);
+            other = _mm256_andnot_si256(_mm256_or_si256(off, on), c);
+            offAll = _mm256_or_si256(offAll, off);
+            onAll = _mm256_or_si256(onAll, on);
+            oppAll = _mm256_or_si256(oppAll, other);
+            // abs(d1dif_fine) >= thres_ydif && abs(d1dif_fine) >= 56
+            const __m256i fineYdif = CmpGe(d1dif_fine, vydif);
+            c = And3(r, fineYdif, CmpGe(d1dif_fine, v56));
+            r = _mm256_andnot_si256(c, r);
+            off = And3(c, _mm256_cmpeq_epi32(as, zero), CmpGe(ar, v3));
+            on = And3(_mm256_andnot_si256(off, c), CmpGe(as, v2), CmpGe(v3, ar));
+            other = _mm256_andnot_si256(_mm256_or_si256(off, on), c);
+            offAll = _mm256_or_si256(offAll, off);
+            onAll = _mm256_or_si256(onAll, on);
+            oppAll = _mm256_or_si256(oppAll, other);
+            // abs(d1dif_fine) >= thres_ydif && thres_ydif > 0
+            if (thres_ydif > 0) {
+                c = _mm256_and_si256(r, fineYdif);
+                r = _mm256_andnot_si256(c, r);
+                off = _mm256_and_si256(c, _mm256_cmpeq_epi32(as, zero));
+                on = And3(_mm256_andnot_si256(off, c), CmpGe(v1, ar), c);
+                other = _mm256_andnot_si256(_mm256_or_si256(off, on), c);
+                offAll = _mm256_or_si256(offAll, off);
+                onAll = _mm256_or_si256(onAll, on);
+                oppAll = _mm256_or_si256(oppAll, other);
+            }
+            // それ以外
+            cntf_logost += CountBits8(MaskBits(r));
+            oppAll = _mm256_or_si256(oppAll, r);
+
+            cntf_logooff += CountBits8(MaskBits(offAll));
+            cntf_offedg += CountBits8(MaskBits(_mm256_and_si256(offAll, val_offedg)));
+            cntf_logoon += CountBits8(MaskBits(onAll));
+            opp = _mm256_or_si256(opp, _mm256_and_si256(oppAll, oppside));
+
+            // フェード用
+            const __m256i f0 = And3(b, _mm256_cmpgt_epi32(dp1, dp0), And3(
+                CmpGe(_mm256_sub_epi32(d1_rev, d0_src), v48),
+                _mm256_cmpgt_epi32(d1, _mm256_sub_epi32(d1s, v4)),
+                _mm256_cmpgt_epi32(_mm256_add_epi32(d1r, v4), d1)));
+            const __m256i f1 = And3(b, _mm256_cmpgt_epi32(dp0, dp1), And3(
+                CmpGe(_mm256_sub_epi32(d0_src, d1_rev), v48),
+                _mm256_cmpgt_epi32(d1, _mm256_sub_epi32(d1r, v4)),
+                _mm256_cmpgt_epi32(_mm256_add_epi32(d1s, v4), d1)));
+            const int bitsf = MaskBits(_mm256_or_si256(f0, f1));
+            if (bitsf) {
+                sum_areaoff += HSum256(_mm256_or_si256(_mm256_and_si256(f0, p0), _mm256_and_si256(f1, p1)));
+                sum_areaon += HSum256(_mm256_or_si256(_mm256_and_si256(f0, p1), _mm256_and_si256(f1, p0)));
+                sum_areadif += HSum256(_mm256_or_si256(
+                    _mm256_and_si256(f0, _mm256_sub_epi32(d1r, d1s)), _mm256_and_si256(f1, _mm256_sub_epi32(d1s, d1r))));
+                sum_areanum += CountBits8(bitsf);
+            }
+        }
+
+        const int bitso = MaskBits(opp);
+        if (bitso) {
+            for (int k = 0; k < 8; ++k) {
+                chkopp[i + k] = (bitso >> k) & 1;
+            }
+        }
+    }
+
+    plogoc->cnt_logooff += (long)cnt_logooff;
+    plogoc->cnt_logoon += (long)cnt_logoon;
+    plogoc->cnt_logomv += (long)cnt_logomv;
+    plogoc->cnt_offedg += (long)cnt_offedg;
+    plogoc->cntf_logooff += (long)cntf_logooff;
+    plogoc->cntf_logoon += (long)cntf_logoon;
+    plogoc->cntf_logost += (long)cntf_logost;
+    plogoc->cntf_offedg += (long)cntf_offedg;
+    plogoc->cnts_logooff += (long)cnts_logooff;
+    plogoc->cnts_logoon += (long)cnts_logoon;
+    plogoc->sum_areaoff += (long)sum_areaoff;
+    plogoc->sum_areaon += (long)sum_areaon;
+    plogoc->sum_areadif += (long)sum_areadif;
+    plogoc->sum_areanum += (long)sum_areanum;
+    return i;
+}
+
+// ---- 時間軸ノイズリダクション ----
+
+static inline __m256i LoadPixels8(const uint8_t* p) {
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p));
+}
+static inline __m256i LoadPixels8(const uint16_t* p) {
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p));
+}
+// 4画素読んで2倍に引き伸ばす（4:2:0の色差を輝度の位置に合わせる）
+static inline __m256i LoadPixels4Dup(const uint8_t* p) {
+    const __m256i v = _mm256_cvtepu8_epi32(_mm_cvtsi32_si128(*(const int*)p));
+    return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3));
+}
+static inline __m256i LoadPixels4Dup(const uint16_t* p) {
+    const __m256i v = _mm256_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)p));
+    return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3));
+}
+static inline void StorePixels8(uint16_t* p, __m256i v) {
+    _mm_storeu_si128((__m128i*)p, _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+static inline void StorePixels8(uint8_t* p, __m256i v) {
+    const __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storel_epi64((__m128i*)p, _mm_packus_epi16(w, w));
+}
+// 偶数番目の4画素だけ書き込む
+static inline void StorePixelsEven4(uint16_t* p, __m256i v) {
+    const __m128i e = _mm256_castsi256_si128(
+        _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6)));
+    _mm_storel_epi64((__m128i*)p, _mm_packus_epi32(e, e));
+}
+static inline void StorePixelsEven4(uint8_t* p, __m256i v) {
+    const __m128i e = _mm256_castsi256_si128(
+        _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6)));
+    const __m128i w = _mm_packus_epi32(e, e);
+    *(int*)p = _mm_cvtsi128_si32(_mm_packus_epi16(w, w));
+}
+
+// TemporalNRRowCと同じ計算を8画素ずつ行う
+// 各参照フレームの判定マスクを保存しておき、重みの合計が出たら加算だけ行う
+// 浮動小数の演算順序はスカラー版と同じなので結果は一致する
+template <typename T>
+static int TemporalNRRowAVX2T(const T* const* srcY, const T* const* srcU, const T* const* srcV,
+    T* dstY, T* dstU, T* dstV, int width, int nframes, int mid, int thresh, const float* kernel) {
+    enum { MAX_NFRAMES = 128 };
+    const __m256i vthresh = _mm256_set1_epi32(thresh);
+    const __m256i vones = _mm256_set1_epi32(-1);
+    const __m256 vone = _mm256_set1_ps(1.0f);
+    const __m256 vhalf = _mm256_set1_ps(0.5f);
+    const bool cout = (dstU != NULL);
+    __m256 match[MAX_NFRAMES];
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const int cx = x >> 1;
+        const __m256i Y = LoadPixels8(srcY[mid] + x);
+        const __m256i U = LoadPixels4Dup(srcU[mid] + cx);
+        const __m256i V = LoadPixels4Dup(srcV[mid] + cx);
+
+        __m256 sumKernel = _mm256_setzero_ps();
+        for (int i = 0; i < nframes; ++i) {
+            const __m256i dY = _mm256_abs_epi32(_mm256_sub_epi32(Y, LoadPixels8(srcY[i] + x)));
+            const __m256i dU = _mm256_abs_epi32(_mm256_sub_epi32(U, LoadPixels4Dup(srcU[i] + cx)));
+            const __m256i dV = _mm256_abs_epi32(_mm256_sub_epi32(V, LoadPixels4Dup(srcV[i] + cx)));
+            const __m256i diff = _mm256_add_epi32(_mm256_add_epi32(dY, dU), dV);
+            // diff <= thresh
+            match[i] = _mm256_castsi256_ps(_mm256_xor_si256(_mm256_cmpgt_epi32(diff, vthresh), vones));
+            // 一致しない画素は+0なので値は変わらない
+            sumKernel = _mm256_add_ps(sumKernel, _mm256_and_ps(match[i], _mm256_set1_ps(kernel[i])));
+        }
+
+        const __m256 factor = _mm256_div_ps(vone, sumKernel);
+
+        __m256 accY = vhalf;
+        __m256 accU = vhalf;
+        __m256 accV = vhalf;
+        for (int i = 0; i < nframes; ++i) {
+            if (_mm256_testz_ps(match[i], match[i])) continue;
+            const __m256 coef = _mm256_mul_ps(_mm256_set1_ps(kernel[i]), factor);
+            const __m256 rY = _mm256_cvtepi32_ps(LoadPixels8(srcY[i] + x));
+            // スカラー版と合わせてfmaは使わない
+            accY = _mm256_blendv_ps(accY, _mm256_add_ps(accY, _mm256_mul_ps(coef, rY)), match[i]);
+            if (cout) {
+                const __m256 rU = _mm256_cvtepi32_ps(LoadPixels4Dup(srcU[i] + cx));
+                const __m256 rV = _mm256_cvtepi32_ps(LoadPixels4Dup(srcV[i] + cx));
+                accU = _mm256_blendv_ps(accU, _mm256_add_ps(accU, _mm256_mul_ps(coef, rU)), match[i]);
+                accV = _mm256_blendv_ps(accV, _mm256_add_ps(accV, _mm256_mul_ps(coef, rV)), match[i]);
+            }
+        }
+
+        StorePixels8(dstY + x, _mm256_cvttps_epi32(accY));
+        if (cout) {
+            StorePixelsEven4(dstU + cx, _mm256_cvttps_epi32(accU));
+            StorePixelsEven4(dstV + cx, _mm256_cvttps_epi32(accV));
+        }
+    }
+    return x;
+}
+
+int TemporalNRRowAVX2(const uint8_t* const* srcY, const uint8_t* const* srcU, const uint8_t* const* srcV,
+    uint8_t* dstY, uint8_t* dstU, uint8_t* dstV, int width, int nframes, int mid, int thresh, const float* kernel) {
+    return TemporalNRRowAVX2T(srcY, srcU, srcV, dstY, dstU, dstV, width, nframes, mid, thresh, kernel);
+}
+int TemporalNRRowAVX2(const uint16_t* const* srcY, const uint16_t* const* srcU, const uint16_t* const* srcV,
+    uint16_t* dstY, uint16_t* dstU, uint16_t* dstV, int width, int nframes, int mid, int thresh, const float* kernel) {
+    return TemporalNRRowAVX2T(srcY, srcU, srcV, dstY, dstU, dstV, width, nframes, mid, thresh, kernel);
+}
@@ -57,22 +57,28 @@ Y4MWriter::Y4MWriter(VideoInfo vi, VideoFormat outfmt) : n(0) {
     nc = vi.IsY() ? 1 : 3;
 }
 void Y4MWriter::inputFrame(const PVideoFrame& frame) {
+    // コピーせずにフレームのメモリをそのまま書き込む
+    chunks.clear();
     if (n++ == 0) {
-        buffer.add(MemoryChunk((uint8_t*)header.data(), header.size()));
+        chunks.emplace_back((uint8_t*)header.data(), header.size());
     }
-    buffer.add(MemoryChunk((uint8_t*)frameHeader.data(), frameHeader.size()));
+    chunks.emplace_back((uint8_t*)frameHeader.data(), frameHeader.size());
     int yuv[] = { PLANAR_Y, PLANAR_U, PLANAR_V };
     for (int c = 0; c < nc; ++c) {
         const uint8_t* plane = frame->GetReadPtr(yuv[c]);
         int pitch = frame->GetPitch(yuv[c]);
         int height = frame->GetHeight(yuv[c]);
         int rowsize = frame->GetRowSize(yuv[c]);
-        for (int y = 0; y < height; ++y) {
-            buffer.add(MemoryChunk((uint8_t*)plane + y * pitch, rowsize));
+        if (pitch == rowsize) {
+            // 隙間がなければプレーン全体を1つで
+            chunks.emplace_back((uint8_t*)plane, (size_t)rowsize * height);
+        } else {
+            for (int y = 0; y < height; ++y) {
+                chunks.emplace_back((uint8_t*)plane + y * pitch, rowsize);
+            }
         }
-        onWrite(buffer.get());
-        buffer.clear();
     }
+    onWrite(chunks);
 }
 /* static */ const char* Y4MEncodeWriter::getYUV(VideoInfo vi) {
     if (vi.Is420()) return "420";
@@ -120,12 +126,12 @@ const std::deque<std::vector<char>>& Y4MEncodeWriter::getLastLines() {
 Y4MEncodeWriter::MyVideoWriter::MyVideoWriter(Y4MEncodeWriter* this_, VideoInfo vi, VideoFormat fmt)
     : Y4MWriter(vi, fmt)
     , this_(this_) {}
-/* virtual */ void Y4MEncodeWriter::MyVideoWriter::onWrite(MemoryChunk mc) {
-    this_->onVideoWrite(mc);
+/* virtual */ void Y4MEncodeWriter::MyVideoWriter::onWrite(const std::vector<MemoryChunk>& chunks) {
+    this_->onVideoWrite(chunks);
 }
 
-void Y4MEncodeWriter::onVideoWrite(MemoryChunk mc) {
-    process_->write(mc);
+void Y4MEncodeWriter::onVideoWrite(const std::vector<MemoryChunk>& chunks) {
+    process_->write(chunks);
 }
 AMTFilterVideoEncoder::AMTFilterVideoEncoder(
     AMTContext&ctx, int numEncodeBufferFrames)
@@ -170,7 +176,7 @@ void AMTFilterVideoEncoder::encode(
             // エンコード
             for (int i = 0; i < vi_.num_frames; ++i) {
                 auto frame = source->GetFrame(i, env);
-                thread_.put(std::unique_ptr<PVideoFrame>(new PVideoFrame(frame)), 1);
+                thread_.put(std::move(frame), 1);
             }
         } catch (const AvisynthError& avserror) {
             ctx.errorF("Avisynthフィルタでエラーが発生: %s", avserror.msg);
@@ -196,11 +202,68 @@ void AMTFilterVideoEncoder::encode(
         ctx.infoF("Total: %.2fs, FilterWait: %.2fs, EncoderWait: %.2fs", sw.getTotal(), prod, cons);
     }
 }
+void ConcatEncodedChunks(AMTContext& ctx, ENUM_ENCODER encoder,
+    const std::vector<tstring>& chunkPaths, const tstring& outpath) {
+    enum {
+        IVF_HEADER_SIZE = 32,
+        IVF_FRAME_HEADER_SIZE = 12,
+        COPY_BUFFER_SIZE = 4 * 1024 * 1024,
+    };
+    File dst(outpath, _T("wb"));
+    std::vector<uint8_t> buf(COPY_BUFFER_SIZE);
+    if (encoder != ENCODER_SVTAV1) {
+        for (const auto& path : chunkPaths) {
+            File src(path, _T("rb"));
+            while (size_t sz = src.read(MemoryChunk(buf.data(), buf.size()))) {
+                dst.write(MemoryChunk(buf.data(), sz));
+            }
+        }
+        ctx.infoF("%d区間を結合", (int)chunkPaths.size());
+        return;
+    }
+    // IVF: 各区間のPTSは0から始まっているので前の区間の続きになるようにずらす
+    uint8_t header[IVF_HEADER_SIZE];
+    uint32_t numFrames = 0;
+    int64_t ptsOffset = 0;
+    for (int i = 0; i < (int)chunkPaths.size(); ++i) {
+        File src(chunkPaths[i], _T("rb"));
+        if (src.read(MemoryChunk(header, IVF_HEADER_SIZE)) != IVF_HEADER_SIZE || memcmp(header, "DKIF", 4) != 0) {
+            THROWF(FormatException, "IVFファイルではありません: %s", chunkPaths[i].c_str());
+        }
+        src.seek(*(uint16_t*)(header + 6), SEEK_SET);
+        if (i == 0) {
+            dst.write(MemoryChunk(header, IVF_HEADER_SIZE));
+        }
+        int64_t maxPts = ptsOffset - 1;
+        uint8_t frameHeader[IVF_FRAME_HEADER_SIZE];
+        while (src.read(MemoryChunk(frameHeader, IVF_FRAME_HEADER_SIZE)) == IVF_FRAME_HEADER_SIZE) {
+            uint32_t frameSize = *(uint32_t*)frameHeader;
+            int64_t pts = *(int64_t*)(frameHeader + 4) + ptsOffset;
+            maxPts = std::max(maxPts, pts);
+            *(int64_t*)(frameHeader + 4) = pts;
+            dst.write(MemoryChunk(frameHeader, IVF_FRAME_HEADER_SIZE));
+            if (buf.size() < frameSize) {
+                buf.resize(frameSize);
+            }
+            if (src.read(MemoryChunk(buf.data(), frameSize)) != frameSize) {
+                THROWF(FormatException, "IVFファイルが途中で切れています: %s", chunkPaths[i].c_str());
+            }
+            dst.write(MemoryChunk(buf.data(), frameSize));
+            ++numFrames;
+        }
+        ptsOffset = maxPts + 1;
+    }
+    // フレーム数を書き換え
+    dst.seek(24, SEEK_SET);
+    dst.writeValue(numFrames);
+    ctx.infoF("%d区間を結合: %dフレーム", (int)chunkPaths.size(), (int)numFrames);
+}
+
 AMTFilterVideoEncoder::SpDataPumpThread::SpDataPumpThread(AMTFilterVideoEncoder* this_, int bufferingFrames)
     : DataPumpThread(bufferingFrames)
     , this_(this_) {}
-/* virtual */ void AMTFilterVideoEncoder::SpDataPumpThread::OnDataReceived(std::unique_ptr<PVideoFrame>&& data) {
-    this_->encoder_->inputFrame(*data);
+/* virtual */ void AMTFilterVideoEncoder::SpDataPumpThread::OnDataReceived(PVideoFrame&& data) {
+    this_->encoder_->inputFrame(data);
 }
 AMTSimpleVideoEncoder::AMTSimpleVideoEncoder(
     AMTContext& ctx,
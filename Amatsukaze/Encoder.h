@@ -19,13 +19,14 @@ public:
     Y4MWriter(VideoInfo vi, VideoFormat outfmt);
     void inputFrame(const PVideoFrame& frame);
 protected:
-    virtual void onWrite(MemoryChunk mc) = 0;
+    // 1フレーム分のデータ（フレームのメモリを直接指す）をまとめて渡す
+    virtual void onWrite(const std::vector<MemoryChunk>& chunks) = 0;
 private:
     int n;
     int nc;
     std::string header;
     std::string frameHeader;
-    AutoBuffer buffer;
+    std::vector<MemoryChunk> chunks;
 };
 
 class Y4MEncodeWriter : AMTObject, NonCopyable {
@@ -45,7 +46,7 @@ private:
     public:
         MyVideoWriter(Y4MEncodeWriter* this_, VideoInfo vi, VideoFormat fmt);
     protected:
-        virtual void onWrite(MemoryChunk mc);
+        virtual void onWrite(const std::vector<MemoryChunk>& chunks);
     private:
         Y4MEncodeWriter* this_;
     };
@@ -53,7 +54,7 @@ private:
     std::unique_ptr<MyVideoWriter> y4mWriter_;
     std::unique_ptr<StdRedirectedSubProcess> process_;
 
-    void onVideoWrite(MemoryChunk mc);
+    void onVideoWrite(const std::vector<MemoryChunk>& chunks);
 };
 
 class AMTFilterVideoEncoder : public AMTObject {
@@ -68,11 +69,11 @@ public:
 
 private:
 
-    class SpDataPumpThread : public DataPumpThread<std::unique_ptr<PVideoFrame>, true> {
+    class SpDataPumpThread : public DataPumpThread<PVideoFrame, true> {
     public:
         SpDataPumpThread(AMTFilterVideoEncoder* this_, int bufferingFrames);
     protected:
-        virtual void OnDataReceived(std::unique_ptr<PVideoFrame>&& data);
+        virtual void OnDataReceived(PVideoFrame&& data);
     private:
         AMTFilterVideoEncoder * this_;
     };
@@ -84,6 +85,11 @@ private:
     SpDataPumpThread thread_;
 };
 
+// 分割エンコードした各区間のビットストリームを順に結合してoutpathに出力する
+// x264(--stitchable)/x265はESをそのまま連結、SVT-AV1はIVFのヘッダとPTSを書き換えて連結する
+void ConcatEncodedChunks(AMTContext& ctx, ENUM_ENCODER encoder,
+    const std::vector<tstring>& chunkPaths, const tstring& outpath);
+
 class AMTSimpleVideoEncoder : public AMTObject {
 public:
     AMTSimpleVideoEncoder(
@@ -186,7 +186,9 @@ AMTFilterSource::AMTFilterSource(AMTContext&ctx,
     : AMTObject(ctx)
     , setting_(setting)
     , env_(make_unique_ptr((IScriptEnvironment2*)nullptr))
-    , vfrTimingFps_(0) {
+    , vfrTimingFps_(0)
+    , encodeRes_()
+    , srcFrameTick_(0) {
     try {
         // フィルタ前処理用リソース確保
         auto res = rm.wait(HOST_CMD_Filter);
@@ -212,6 +214,7 @@ AMTFilterSource::AMTFilterSource(AMTContext&ctx,
 
         // エンコード用リソースでアフィニティを設定
         res = encodeRes;
+        encodeRes_ = encodeRes;
         SetCPUAffinity(res.group, res.mask);
         if (env_ == nullptr) {
             FilterPass(pass, res.gpuIndex, key, reformInfo, logopath);
@@ -291,6 +294,46 @@ IScriptEnvironment2* AMTFilterSource::getEnv() const {
     return env_.get();
 }
 
+const ResourceAllocation& AMTFilterSource::getEncodeResource() const {
+    return encodeRes_;
+}
+
+std::vector<int> AMTFilterSource::getOutFrames(const std::vector<int>& srcFrames) const {
+    std::vector<int> frames;
+    for (int frame : srcFrames) {
+        auto it = std::lower_bound(srcFrames_.begin(), srcFrames_.end(), frame);
+        if (it == srcFrames_.end() || *it != frame) {
+            continue;
+        }
+        int outFrame = toOutFrame((int)(it - srcFrames_.begin()));
+        if (frames.size() == 0 || frames.back() < outFrame) {
+            frames.push_back(outFrame);
+        }
+    }
+    return frames;
+}
+
+PClip AMTFilterSource::createClip(ScriptEnvironmentPointer& env) const {
+    env = CreateEnv();
+    if (env == nullptr) {
+        THROW(RuntimeException, "Avisynth環境を作成できません");
+    }
+    PClip clip;
+    try {
+        // スクリプトは最後の結果をlastに入れて終わっている
+        env->SetVar("last", env->Invoke("Eval", script_.Str().c_str()));
+        clip = env->GetVar("last").AsClip();
+    } catch (const AvisynthError& avserror) {
+        THROWF(AviSynthException, "%s", avserror.msg);
+    }
+    return clip;
+}
+
+void AMTFilterSource::releaseClip() {
+    filter_ = nullptr;
+    env_ = nullptr;
+}
+
 void AMTFilterSource::writeScriptFile(EncodeFileKey key) {
     auto& str = script_.Str();
     File avsfile(setting_.getFilterAvsPath(key), _T("w"));
@@ -338,23 +381,30 @@ std::vector<tstring> AMTFilterSource::GetSuitablePlugins(const tstring& basepath
 
 #include <dlfcn.h>
 const AVS_Linkage *AVS_linkage = nullptr;
-void AMTFilterSource::InitEnv() {
-    env_ = nullptr;
+/* static */ ScriptEnvironmentPointer AMTFilterSource::CreateEnv() {
     void *handle = dlopen("libavisynth.so", RTLD_LAZY);
 	if (handle == NULL) {
 		perror("Cannot load libavisynth.so");
-		return;
+		return make_unique_ptr((IScriptEnvironment2*)nullptr);
 	}
 	void *mkr = dlsym(handle, "CreateScriptEnvironment2");
 	if(mkr == NULL) {
 		perror("Cannot find CreateScriptEnvironment2");
-		return;
+		return make_unique_ptr((IScriptEnvironment2*)nullptr);
 	}
 	typedef IScriptEnvironment2 * (* func_t)(int);
 	func_t CreateScriptEnvironment2 = (func_t)mkr;
-	env_ = make_unique_ptr(CreateScriptEnvironment2(AVISYNTH_INTERFACE_VERSION));
+	auto env = make_unique_ptr(CreateScriptEnvironment2(AVISYNTH_INTERFACE_VERSION));
     if (AVS_linkage == nullptr) {
-  	    AVS_linkage = env_->GetAVSLinkage();
+  	    AVS_linkage = env->GetAVSLinkage();
+    }
+    return env;
+}
+void AMTFilterSource::InitEnv() {
+    env_ = nullptr;
+    env_ = CreateEnv();
+    if (env_ == nullptr) {
+        return;
     }
 	
     script_.Clear();
@@ -412,7 +462,8 @@ void AMTFilterSource::defineMakeSource(
     auto& sb = script_.Get();
     sb.append("function MakeSource(bool \"mt\") {\n");
     sb.append("\tmt = default(mt, false)\n");
-    sb.append("\tAMTSource(\"%s\")\n", setting_.getTmpAMTSourcePath(key.video).c_str());
+    sb.append("\tAMTSource(\"%s\", decoders=%d, cachemb=%d)\n",
+        setting_.getTmpAMTSourcePath(key.video).c_str(), setting_.getNumSourceDecoders(), setting_.getSourceCacheSizeMB());
     sb.append("\tif(mt) { Prefetch(1, 4) }\n");
 
     /*
@@ -517,6 +568,9 @@ void AMTFilterSource::MakeZones(
     const std::vector<EncoderZone>& zones,
     const StreamReformInfo& reformInfo) {
     const auto& outFrames = reformInfo.getEncodeFile(key).videoFrames;
+    const VideoFormat& infmt = reformInfo.getFormat(key).videoFormat;
+    srcFrames_.assign(outFrames.begin(), outFrames.end());
+    srcFrameTick_ = (double)infmt.frameRateDenom / infmt.frameRateNum;
 
     // このencoderIndex用のゾーンを作成
     outZones_.clear();
@@ -536,7 +590,6 @@ void AMTFilterSource::MakeZones(
     VideoInfo outvi = filter_->GetVideoInfo();
     int numOutFrames = outvi.num_frames;
 
-    const VideoFormat& infmt = reformInfo.getFormat(key).videoFormat;
     double srcDuration = (double)numSrcFrames * infmt.frameRateDenom / infmt.frameRateNum;
     double clipDuration = timeCodes_.size()
         ? timeCodes_.back() / 1000.0
@@ -564,21 +617,25 @@ void AMTFilterSource::MakeZones(
         ctx.warn("フレーム数が変わっていますがインターレースのままです。プログレッシブ出力が目的ならAssumeBFF()をavsファイルの最後に追加してください。");
     }
 
+    for (int i = 0; i < (int)outZones_.size(); ++i) {
+        outZones_[i].startFrame = toOutFrame(outZones_[i].startFrame);
+        outZones_[i].endFrame = toOutFrame(outZones_[i].endFrame);
+    }
+}
+
+// trim後の入力フレーム位置をフィルタ出力のフレーム位置に変換
+int AMTFilterSource::toOutFrame(int frame) const {
+    int numSrcFrames = (int)srcFrames_.size();
+    int numOutFrames = filter_->GetVideoInfo().num_frames;
     if (timeCodes_.size()) {
-        // VFRタイムスタンプをoutZonesに反映させる
-        double tick = (double)infmt.frameRateDenom / infmt.frameRateNum;
-        for (int i = 0; i < (int)outZones_.size(); ++i) {
-            outZones_[i].startFrame = (int)(std::lower_bound(timeCodes_.begin(), timeCodes_.end(), outZones_[i].startFrame * tick * 1000) - timeCodes_.begin());
-            outZones_[i].endFrame = (int)(std::lower_bound(timeCodes_.begin(), timeCodes_.end(), outZones_[i].endFrame * tick * 1000) - timeCodes_.begin());
-        }
+        // VFRタイムスタンプを反映させる
+        return (int)(std::lower_bound(timeCodes_.begin(), timeCodes_.end(), frame * srcFrameTick_ * 1000) - timeCodes_.begin());
     } else if (numSrcFrames != numOutFrames) {
-        // フレーム数が変わっている場合はゾーンを引き伸ばす
+        // フレーム数が変わっている場合は引き伸ばす
         double scale = (double)numOutFrames / numSrcFrames;
-        for (int i = 0; i < (int)outZones_.size(); ++i) {
-            outZones_[i].startFrame = std::max(0, std::min(numOutFrames, (int)std::round(outZones_[i].startFrame * scale)));
-            outZones_[i].endFrame = std::max(0, std::min(numOutFrames, (int)std::round(outZones_[i].endFrame * scale)));
-        }
+        return std::max(0, std::min(numOutFrames, (int)std::round(frame * scale)));
     }
+    return frame;
 }
 
 void AMTFilterSource::MakeOutFormat(const VideoFormat& infmt) {
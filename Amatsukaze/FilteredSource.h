@@ -83,6 +83,20 @@ public:
 
     IScriptEnvironment2* getEnv() const;
 
+    // エンコード用に確保したリソース
+    const ResourceAllocation& getEncodeResource() const;
+
+    // ソースのフレーム番号をフィルタ出力のフレーム番号に変換する（カットされたフレームは除く）
+    std::vector<int> getOutFrames(const std::vector<int>& srcFrames) const;
+
+    // 同じフィルタスクリプトを新しい環境で実行したクリップを返す（分割エンコード用）
+    // クリップを解放してから環境を破棄すること
+    PClip createClip(ScriptEnvironmentPointer& env) const;
+
+    // メインのクリップと環境を解放する（分割エンコード前にメモリを空けるため）
+    // 呼び出し後はgetClip(),getEnv()は使えない
+    void releaseClip();
+
 private:
     const ConfigWrapper& setting_;
     ScriptEnvironmentPointer env_;
@@ -92,6 +106,12 @@ private:
     std::vector<EncoderZone> outZones_;
     std::vector<double> timeCodes_;
     int vfrTimingFps_;
+    ResourceAllocation encodeRes_;
+    // trim後の入力フレーム（ソースのフレーム番号）
+    std::vector<int> srcFrames_;
+    double srcFrameTick_;
+
+    static ScriptEnvironmentPointer CreateEnv();
 
     void writeScriptFile(EncodeFileKey key);
 
@@ -120,6 +140,8 @@ private:
         const std::vector<EncoderZone>& zones,
         const StreamReformInfo& reformInfo);
 
+    int toOutFrame(int frame) const;
+
     void MakeOutFormat(const VideoFormat& infmt);
 };
 
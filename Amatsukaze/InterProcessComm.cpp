@@ -10,6 +10,12 @@
 #include "InterProcessComm.h"
 #include "PerformanceUtil.h"
 
+#ifndef _WIN32
+#ifndef INVALID_HANDLE_VALUE
+#define INVALID_HANDLE_VALUE -1
+#endif
+#endif
+
 /* static */ std::string toJsonString(const std::string& str) {
     if (str.size() == 0) {
         return std::string();
@@ -114,7 +120,14 @@ ResourceAllocation ResourceManger::readCommand(int expected) const {
 ResourceManger::ResourceManger(AMTContext& ctx, HANDLE inPipe, HANDLE outPipe)
     : AMTObject(ctx)
     , inPipe(inPipe)
-    , outPipe(outPipe) {}
+    , outPipe(outPipe)
+    , fixedAllocation(DefaultAllocation()) {}
+
+ResourceManger::ResourceManger(AMTContext& ctx, const ResourceAllocation& allocation)
+    : AMTObject(ctx)
+    , inPipe(INVALID_HANDLE_VALUE)
+    , outPipe(INVALID_HANDLE_VALUE)
+    , fixedAllocation(allocation) {}
 
 bool ResourceManger::isInvalidHandle(HANDLE handle) const {
 #ifdef _WIN32
@@ -126,7 +139,7 @@ bool ResourceManger::isInvalidHandle(HANDLE handle) const {
 
 ResourceAllocation ResourceManger::request(PipeCommand phase) const {
     if (isInvalidHandle(inPipe)) {
-        return DefaultAllocation();
+        return fixedAllocation;
     }
     writeCommand(phase | HOST_CMD_NoWait);
     return readCommand(phase);
@@ -135,7 +148,7 @@ ResourceAllocation ResourceManger::request(PipeCommand phase) const {
 // リソース確保できるまで待つ
 ResourceAllocation ResourceManger::wait(PipeCommand phase) const {
     if (isInvalidHandle(inPipe)) {
-        return DefaultAllocation();
+        return fixedAllocation;
     }
     ResourceAllocation ret = request(phase);
     if (ret.IsFailed()) {
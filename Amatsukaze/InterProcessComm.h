@@ -39,6 +39,8 @@ struct ResourceAllocation {
 class ResourceManger : AMTObject {
     HANDLE inPipe;
     HANDLE outPipe;
+    // ホストがいないときに返す割り当て
+    ResourceAllocation fixedAllocation;
 
     void write(MemoryChunk mc) const;
 
@@ -62,6 +64,9 @@ class ResourceManger : AMTObject {
 public:
     ResourceManger(AMTContext& ctx, HANDLE inPipe, HANDLE outPipe);
 
+    // ホストと通信せず常に指定の割り当てを返す（並列エンコードで確保済みリソースを分配する用）
+    ResourceManger(AMTContext& ctx, const ResourceAllocation& allocation);
+
     ResourceAllocation request(PipeCommand phase) const;
 
     // リソース確保できるまで待つ
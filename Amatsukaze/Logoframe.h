@@ -178,6 +178,7 @@ typedef struct {
 	short    *area_y;				/* ロゴエリア情報（0:中間 1:背景 2:ロゴ） */
 	short    most_logo_y;			/* 最も多いロゴの輝度値 */
 	short    thres_dp_y;			/* ロゴ透過度閾値 */
+	uint8_t  *chkopp;				/* SIMD版エッジ検出の作業領域（ロゴ幅+8） */
 
 	/* ロゴ内容確認用 */
 	long     total_dif;				/* エッジ検出箇所の総数 */
@@ -428,6 +429,12 @@ typedef struct {
 	short num_disable;								// 無効判断ロゴ数
 } MLOGO_DATASET;
 
+// logo calc
+extern int LogoCalc_simd;		// SIMD演算（-1:自動 0:使わない 1:AVX2）
+int  LogoCalc_getdif(LOGO_CALCREC *plogoc1, LOGO_CALCREC *plogoc2, LOGO_PARAMREC *plogop,
+					const BYTE *data, int pitch, short thres_ymax, short thres_yedge,
+					short thres_ydif, short thres_yoffedg, uint8_t *chkopp);
+
 // logo function
 void MultLogoInit(MLOGO_DATASET* pml);
 void MultLogoFree(MLOGO_DATASET* pml);
@@ -437,6 +444,8 @@ int  MultLogoOptionOrgFile(MLOGO_DATASET* pml);
 int  MultLogoSetup(MLOGO_DATASET* pml, int num_frames);
 void MultLogoDisplayParam(MLOGO_DATASET* pml);
 void MultLogoCalc(MLOGO_DATASET* pml, const BYTE *data, int pitch, int nframe, int height);
+int  MultLogoCalcWork(MLOGO_DATASET* pml, int nlogo, LOGO_CALCREC *plogoc1, LOGO_CALCREC *plogoc2,
+					  uint8_t *chkopp, const BYTE *data, int pitch, int nframe, int height);
 void MultLogoFind(MLOGO_DATASET* pml);
 extern int  MultLogoWrite(MLOGO_DATASET* pml);
 
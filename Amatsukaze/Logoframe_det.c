@@ -19,6 +19,16 @@ typedef unsigned char BYTE;
 #include <stdint.h>
 #include "Logoframe.h"
 
+// SIMD版（ComputeKernel.cpp）
+bool IsAVX2Available();
+int LogoCalcDifAVX2(LOGO_CALCREC* plogoc,
+	const uint8_t* data0, const uint8_t* data1, const char* dif,
+	const short* dp_y0, const short* y0, const short* dp_y1, const short* y1,
+	int num, short thres_ymax, short thres_yedge, short thres_ydif, short thres_yoffedg,
+	short most_logo_y, uint8_t* chkopp);
+
+int LogoCalc_simd = -1;
+
 //--- 透過ロゴ変換式 ---
 #define ConvLogo(d,dp_y,y)    (((d) * (LOGO_MAX_DP - (dp_y)) + (y) * (dp_y) + LOGO_MAX_DP/2) / LOGO_MAX_DP)
 #define ConvInvLogo(d,dp_y,y) (((d) * LOGO_MAX_DP - (y) * (dp_y) + (LOGO_MAX_DP - (dp_y))/2) / (LOGO_MAX_DP - (dp_y)))
@@ -37,6 +47,7 @@ void LogoInit(LOGO_DATASET *pl){
 	pl->paramdat.dif_y_col = NULL;
 	pl->paramdat.dif_y_row = NULL;
 	pl->paramdat.area_y    = NULL;
+	pl->paramdat.chkopp    = NULL;
 	pl->framedat.rate_logoon = NULL;
 	pl->framedat.rate_fade = NULL;
 	pl->framedat.flag_nosample = NULL;
@@ -86,6 +97,8 @@ void LogoFree_read(LOGO_DATASET *pl){
 		free(pl->paramdat.dif_y_row);
 	if (pl->paramdat.area_y)
 		free(pl->paramdat.area_y);
+	if (pl->paramdat.chkopp)
+		free(pl->paramdat.chkopp);
 
 	pl->readdat.ptr = NULL;
 }
@@ -431,9 +444,10 @@ int LogoSet_mem(LOGO_PARAMREC *plogop, const LOGO_READREC *plogor, const LOGO_TH
 	plogop->dif_y_col  = (char *)malloc( sizeof(char)  * total_y );
 	plogop->dif_y_row  = (char *)malloc( sizeof(char)  * total_y );
 	plogop->area_y     = (short *)malloc( sizeof(short)  * total_y );
+	plogop->chkopp     = (uint8_t *)malloc( sizeof(uint8_t) * (plogop->yw + 8) );
 	if ((plogop->dp_y  == NULL) || (plogop->y  == NULL) ||
 		(plogop->dif_y_col  == NULL) || (plogop->dif_y_row  == NULL) ||
-		(plogop->area_y == NULL)){
+		(plogop->area_y == NULL) || (plogop->chkopp == NULL)){
 		fprintf(stderr, "error: failed in memory allocation.\n");
 		return 2;
 	}
@@ -1614,6 +1628,44 @@ int LogoCalc_getdif_pix(LOGO_CALCREC *plogoc, BYTE data0, BYTE data1,
 }
 
 
+//---------------------------------------------------------------------
+// １画像−演算−エッジ検出（SIMD版）
+// 横に並んだnum画素分をLogoCalc_getdif_pix(exe_type=0)と同じ結果になるように計算
+// SIMDで処理できない端数はスカラー版で計算する
+//---------------------------------------------------------------------
+void LogoCalc_getdif_line(LOGO_CALCREC *plogoc, const BYTE *data0, const BYTE *data1,
+						const char *dif, const short *dp_y0, const short *y0,
+						const short *dp_y1, const short *y1, int num,
+						short thres_ymax, short thres_yedge, short thres_ydif,
+						short thres_yoffedg, short most_logo_y, uint8_t *chkopp){
+	const int thres_dpysmin = 100;
+	int j;
+	int num_simd;
+
+	num_simd = LogoCalcDifAVX2(plogoc, data0, data1, dif, dp_y0, y0, dp_y1, y1, num,
+						thres_ymax, thres_yedge, thres_ydif, thres_yoffedg,
+						most_logo_y, chkopp);
+	// check opposite side
+	for(j=0; j<num_simd; j++){
+		if (chkopp[j] > 0){
+			LogoCalc_getdif_pix(plogoc, data1[j], data0[j],
+						dp_y0[j], y0[j], dp_y1[j], y1[j],
+						thres_ymax, thres_yedge, thres_ydif, thres_dpysmin,
+						most_logo_y, 1);		// exe_type = 1
+		}
+	}
+	for(j=num_simd; j<num; j++){
+		if (dif[j] > 0){
+			LogoCalc_getdif_pix(
+					plogoc, data0[j], data1[j],
+					dp_y0[j], y0[j], dp_y1[j], y1[j],
+					thres_ymax, thres_yedge, thres_ydif, thres_yoffedg,
+					most_logo_y, 0 );
+		}
+	}
+}
+
+
 //---------------------------------------------------------------------
 // １画像−演算−エリア検出
 // エリア検出アルゴリズム用：画素データを領域別に記憶
@@ -1883,7 +1935,7 @@ int LogoCalc_getdif_vcresult(LOGO_CALCREC *plogoc, LOGO_VCCALCREC *pvc){
 //---------------------------------------------------------------------
 int LogoCalc_getdif(LOGO_CALCREC *plogoc1, LOGO_CALCREC *plogoc2, LOGO_PARAMREC *plogop,
 					const BYTE *data, int pitch, short thres_ymax, short thres_yedge,
-					short thres_ydif, short thres_yoffedg){
+					short thres_ydif, short thres_yoffedg, uint8_t *chkopp){
 	LOGO_CALCREC  *plogoc;
 	LOGO_VCCALCREC *pvc;
 	LOGO_VCCALCREC vc1_rec, vc2_rec;
@@ -1896,6 +1948,14 @@ int LogoCalc_getdif(LOGO_CALCREC *plogoc1, LOGO_CALCREC *plogoc2, LOGO_PARAMREC
 	const BYTE *pt_data_line;
 	const BYTE *pt_data0, *pt_data1;
 	const int interval = 2;
+	int use_simd;
+	long num_simd;
+
+	// SIMD（作業領域がなければスカラー版）
+	use_simd = (LogoCalc_simd < 0)? IsAVX2Available() : LogoCalc_simd;
+	if (chkopp == NULL){
+		use_simd = 0;
+	}
 
 	// initialize
 	LogoCalc_getdif_vccalc(&vc1_rec, plogoc1, 0);
@@ -1924,8 +1984,19 @@ int LogoCalc_getdif(LOGO_CALCREC *plogoc1, LOGO_CALCREC *plogoc2, LOGO_PARAMREC
 		pt_data1 = &(pt_data_line[interval]);
 		logo_num0 = logo_numline;
 		logo_num1 = logo_numline + interval;
+		// 右端interval画素は次の行のロゴデータを参照するのでスカラー版で計算
+		num_simd = 0;
+		if (use_simd > 0 && logo_width > interval){
+			num_simd = logo_width - interval;
+			LogoCalc_getdif_line(
+					plogoc, pt_data0, pt_data1, &(plogop->dif_y_col[logo_num0]),
+					&(plogop->dp_y[logo_num0]), &(plogop->y[logo_num0]),
+					&(plogop->dp_y[logo_num1]), &(plogop->y[logo_num1]), num_simd,
+					thres_ymax, thres_yedge, thres_ydif, thres_yoffedg,
+					plogop->most_logo_y, chkopp);
+		}
 		for(j=0; j<logo_width; j++){
-			if (plogop->dif_y_col[logo_num0] > 0){
+			if (j >= num_simd && plogop->dif_y_col[logo_num0] > 0){
 				LogoCalc_getdif_pix(
 						plogoc, *pt_data0, *pt_data1,
 						plogop->dp_y[logo_num0], plogop->y[logo_num0],
@@ -1975,8 +2046,19 @@ int LogoCalc_getdif(LOGO_CALCREC *plogoc1, LOGO_CALCREC *plogoc2, LOGO_PARAMREC
 		pt_data1 = &(pt_data_line[pitch * interval]);
 		logo_num0 = logo_numline;
 		logo_num1 = logo_numline + (logo_width * interval);
+		// 下端interval行はロゴデータの範囲外を参照するのでスカラー版で計算
+		num_simd = 0;
+		if (use_simd > 0 && i < logo_height - interval){
+			num_simd = logo_width;
+			LogoCalc_getdif_line(
+					plogoc, pt_data0, pt_data1, &(plogop->dif_y_row[logo_num0]),
+					&(plogop->dp_y[logo_num0]), &(plogop->y[logo_num0]),
+					&(plogop->dp_y[logo_num1]), &(plogop->y[logo_num1]), num_simd,
+					thres_ymax, thres_yedge, thres_ydif, thres_yoffedg,
+					plogop->most_logo_y, chkopp);
+		}
 		for(j=0; j<logo_width; j++){
-			if (plogop->dif_y_row[logo_num0] > 0){
+			if (j >= num_simd && plogop->dif_y_row[logo_num0] > 0){
 				LogoCalc_getdif_pix(
 						plogoc, *pt_data0, *pt_data1,
 						plogop->dp_y[logo_num0], plogop->y[logo_num0],
@@ -2695,16 +2777,17 @@ void LogoCalc_savedata(LOGO_FRAMEREC *plogof, LOGO_CALCREC *plogoc1, LOGO_CALCRE
 }
 
 //=====================================================================
-// Public関数：画像１枚に対するロゴ検出を行う
-// １枚の画像データのロゴ有無を取得
-//   data      : 画像データ輝度値へのポインタ
-//   pitch     : 画像データの１行データ数
-//   nframe    : フレーム番号
+// Public関数：画像１枚に対するロゴ検出を行う（作業領域指定）
+// LogoCalcと同じ処理を指定した作業領域で行う
+// 結果はframedatのnframe番目にしか書き込まないので
+// 作業領域をスレッドごとに用意すれば複数フレームを並列に処理できる
+//   plogoc1   : 作業領域（Bottom field）
+//   plogoc2   : 作業領域（Top field）
+//   chkopp    : SIMD用作業領域（ロゴ幅+8バイト）
 //=====================================================================
-void LogoCalc(LOGO_DATASET *pl, const BYTE *data, int pitch, int nframe){
+void LogoCalcWork(LOGO_DATASET *pl, LOGO_CALCREC *plogoc1, LOGO_CALCREC *plogoc2,
+				  uint8_t *chkopp, const BYTE *data, int pitch, int nframe){
 	LOGO_PARAMREC *plogop  = &(pl->paramdat);
-	LOGO_CALCREC  *plogoc1 = &(pl->calcdat1);	// for Bottom field of interlace
-	LOGO_CALCREC  *plogoc2 = &(pl->calcdat2);	// for Top field of interlace
 	LOGO_FRAMEREC *plogof  = &(pl->framedat);
 	LOGO_THRESREC *plogot  = &(pl->thresdat);
 
@@ -2712,7 +2795,7 @@ void LogoCalc(LOGO_DATASET *pl, const BYTE *data, int pitch, int nframe){
 	LogoCalc_clear( plogoc2, plogot->num_fadein, plogot->num_fadeout );
 	LogoCalc_getdif( plogoc1, plogoc2, plogop, data, pitch,
 					 plogot->thres_ymax, plogot->thres_yedge,
-					 plogot->thres_ydif, plogot->thres_yoffedg);
+					 plogot->thres_ydif, plogot->thres_yoffedg, chkopp);
 	LogoCalc_summary( plogoc1, plogop );
 	LogoCalc_summary( plogoc2, plogop );
 	LogoCalc_areasummary( plogoc1, plogot->thres_yedge, plogot->num_areaset );
@@ -2721,6 +2804,18 @@ void LogoCalc(LOGO_DATASET *pl, const BYTE *data, int pitch, int nframe){
 }
 
 
+//=====================================================================
+// Public関数：画像１枚に対するロゴ検出を行う
+// １枚の画像データのロゴ有無を取得
+//   data      : 画像データ輝度値へのポインタ
+//   pitch     : 画像データの１行データ数
+//   nframe    : フレーム番号
+//=====================================================================
+void LogoCalc(LOGO_DATASET *pl, const BYTE *data, int pitch, int nframe){
+	LogoCalcWork( pl, &(pl->calcdat1), &(pl->calcdat2), pl->paramdat.chkopp, data, pitch, nframe );
+}
+
+
 //=====================================================================
 // Public関数：デバッグ用に画像１枚のロゴ計算結果を出力
 // １フレーム分ロゴ計算結果を出力（デバッグ用）
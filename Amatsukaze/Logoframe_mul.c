@@ -34,6 +34,8 @@ extern void LogoFree(LOGO_DATASET *pl);
 extern int  LogoRead(const char *logofname, LOGO_DATASET *pl);
 extern int  LogoFrameInit(LOGO_DATASET *pl, long num_frames);
 extern void LogoCalc(LOGO_DATASET *pl, const BYTE *data, int pitch, int nframe);
+extern void LogoCalcWork(LOGO_DATASET *pl, LOGO_CALCREC *plogoc1, LOGO_CALCREC *plogoc2,
+						 uint8_t *chkopp, const BYTE *data, int pitch, int nframe);
 extern void LogoWriteFrameParam(LOGO_DATASET *pl, int nframe, FILE *fpo_ana2);
 extern void LogoFind(LOGO_DATASET *pl);
 extern long LogoGetTotalFrame(LOGO_DATASET *pl);
@@ -1322,6 +1324,20 @@ void MultLogoDisplayParam(MLOGO_DATASET* pml){
 
 //##### １フレーム毎の実行処理
 
+//---------------------------------------------------------------------
+// ロゴデータが画像内にあるか確認
+//---------------------------------------------------------------------
+int MultLogoCalc_InImage(LOGO_DATASET* plogo, int pitch, int height){
+	// 画像外メモリアクセスで落ちることを防ぐために追加
+	if ((plogo->paramdat.yx + plogo->paramdat.yw <= pitch+8 &&
+		 plogo->paramdat.yy + plogo->paramdat.yh <  height-1) ||
+	    (plogo->paramdat.yx + plogo->paramdat.yw <  pitch   &&
+		 plogo->paramdat.yy + plogo->paramdat.yh <  height  )){
+		return 1;
+	}
+	return 0;
+}
+
 //=====================================================================
 // Public関数：画像１枚に対するロゴ検出を行う
 // １枚の画像データのロゴ有無を取得
@@ -1337,11 +1353,7 @@ void MultLogoCalc(MLOGO_DATASET* pml, const BYTE *data, int pitch, int nframe, i
 	for(i = 0; i < LOGONUM_MAX; i++){
 		plogo      = pml->all_logodata[i];
 		if (plogo != NULL){
-			// 画像外メモリアクセスで落ちることを防ぐために追加
-			if ((plogo->paramdat.yx + plogo->paramdat.yw <= pitch+8 &&
-				 plogo->paramdat.yy + plogo->paramdat.yh <  height-1) ||
-			    (plogo->paramdat.yx + plogo->paramdat.yw <  pitch   &&
-				 plogo->paramdat.yy + plogo->paramdat.yh <  height  )){
+			if (MultLogoCalc_InImage(plogo, pitch, height)){
 		        LogoCalc( plogo, data, pitch, nframe );
 		        if (pml->fpo_ana2[i] != NULL){     // for debug
 					LogoWriteFrameParam( plogo, nframe, pml->fpo_ana2[i] );
@@ -1353,6 +1365,29 @@ void MultLogoCalc(MLOGO_DATASET* pml, const BYTE *data, int pitch, int nframe, i
 
 
 
+//=====================================================================
+// Public関数：画像１枚に対する１ロゴ分のロゴ検出を作業領域を指定して行う
+// MultLogoCalcをフレーム・ロゴ単位で並列に実行するために使用
+// デバッグ用毎フレーム情報（-oa2）は出力しない
+//   nlogo     : ロゴ番号
+//   plogoc1, plogoc2 : 作業領域
+//   chkopp    : SIMD用作業領域（ロゴ幅+8バイト以上）
+//   戻り値    : 1=検出実行 0=ロゴなしまたは画像外
+//=====================================================================
+int MultLogoCalcWork(MLOGO_DATASET* pml, int nlogo, LOGO_CALCREC *plogoc1, LOGO_CALCREC *plogoc2,
+					 uint8_t *chkopp, const BYTE *data, int pitch, int nframe, int height){
+	LOGO_DATASET* plogo;
+
+	plogo = pml->all_logodata[nlogo];
+	if (plogo == NULL || MultLogoCalc_InImage(plogo, pitch, height) == 0){
+		return 0;
+	}
+	LogoCalcWork( plogo, plogoc1, plogoc2, chkopp, data, pitch, nframe );
+	return 1;
+}
+
+
+
 //##### 全フレーム読み込み後の検出処理
 
 //---------------------------------------------------------------------
@@ -236,13 +236,57 @@ void PESPacket::writeTimeStamp(uint8_t* ptr, int64_t TS) {
     bms(raw, 1, 0, 1); // marker_bit
     write40(ptr, raw);
 }
+int CountSyncBytesC(const uint8_t* ptr, int numPackets) {
+    int i = 0;
+    for (; i < numPackets; ++i) {
+        if (ptr[TS_PACKET_LENGTH * i] != TS_SYNC_BYTE) break;
+    }
+    return i;
+}
+
+int FindSyncOffsetC(const uint8_t* ptr, int length, int numPackets) {
+    const int last = length - numPackets * TS_PACKET_LENGTH;
+    for (int offset = 0; offset <= last; ++offset) {
+        if (CountSyncBytesC(ptr + offset, numPackets) == numPackets) {
+            return offset;
+        }
+    }
+    return std::max(0, last + 1);
+}
+
 TsPacketParser::TsPacketParser(AMTContext& ctx)
     : AMTObject(ctx)
-    , syncOK(false) {}
+    , syncOK(false) {
+    if (IsAVX2Available()) {
+        countSyncBytes = CountSyncBytesAVX2;
+        findSyncOffset = FindSyncOffsetAVX2;
+    } else {
+        countSyncBytes = CountSyncBytesC;
+        findSyncOffset = FindSyncOffsetC;
+    }
+}
 
 /** @brief TSデータを入力 */
 void TsPacketParser::inputTS(MemoryChunk data) {
 
+    if (syncOK && buffer.size() == 0) {
+        // 同期が取れていてバッファが空なら入力データから直接切り出す
+        // 出力はバッファ経由と全く同じになる
+        size_t offset = 0;
+        // 次のパケットの同期バイトも合っているパケットだけ出力できる
+        int numOut = std::max(0, countSyncBytes(data.data, int(data.length / TS_PACKET_LENGTH)) - 1);
+        for (int i = 0; i < numOut; ++i) {
+            checkAndOutPacket(MemoryChunk(data.data + offset, TS_PACKET_LENGTH));
+            if (!syncOK) {
+                // onTsPacketでresetが呼ばれたら残りは捨てる
+                return;
+            }
+            offset += TS_PACKET_LENGTH;
+        }
+        // 同期が外れたところ以降と端数だけバッファに入れる
+        data = MemoryChunk(data.data + offset, data.length - offset);
+    }
+
     buffer.add(data);
 
     if (syncOK) {
@@ -254,9 +298,9 @@ void TsPacketParser::inputTS(MemoryChunk data) {
             syncOK = true;
             outPackets();
         } else {
-            // ダメだったので1バイトスキップ
+            // ダメだったので同期が取れる位置までスキップ
             syncOK = false;
-            buffer.trimHead(1);
+            buffer.trimHead(findSyncOffset(buffer.ptr(), (int)buffer.size(), CHECK_PACKET_NUM));
         }
     }
 }
@@ -292,10 +336,13 @@ bool TsPacketParser::checkSyncByte(uint8_t* ptr, int numPacket) {
 
 // 「先頭と次のパケットの同期バイトを見て合っていれば出力」を繰り返す
 void TsPacketParser::outPackets() {
-    while (buffer.size() >= 2 * TS_PACKET_LENGTH &&
-        checkSyncByte(buffer.ptr(), 2)) {
+    int numOut = std::max(0, countSyncBytes(buffer.ptr(), int(buffer.size() / TS_PACKET_LENGTH)) - 1);
+    for (int i = 0; i < numOut; ++i) {
         checkAndOutPacket(MemoryChunk(buffer.ptr(), TS_PACKET_LENGTH));
         // onTsPacketでresetが呼ばれるかもしれないので注意
+        if (!syncOK) {
+            return;
+        }
         buffer.trimHead(TS_PACKET_LENGTH);
     }
 }
@@ -760,6 +807,21 @@ PsiUpdatedDetector::PsiUpdatedDetector(AMTContext&ctx)
         onTableUpdated(clock, section);
     }
 }
+PidBitmap::PidBitmap() {
+    clear();
+}
+
+void PidBitmap::clear() {
+    std::fill(std::begin(bits), std::end(bits), 0);
+}
+
+void PidBitmap::set(int pid) {
+    if (pid < 0 || pid > MAX_PID) {
+        return;
+    }
+    bits[pid >> 6] |= (uint64_t)1 << (pid & 63);
+}
+
 PidHandlerTable::PidHandlerTable()
     : table() {}
 
@@ -841,11 +903,13 @@ TsPacketSelector::TsPacketSelector(AMTContext& ctx)
     , pmtPid(-1)
     , videoDelegator(*this)
     , captionDelegator(*this)
+    , pcrPid(-1)
     , startClock(-1) {
     curHandlerTable = new PidHandlerTable();
     initHandlerTable(curHandlerTable);
     nextHandlerTable = new PidHandlerTable();
     initHandlerTable(nextHandlerTable);
+    updatePidMap();
 }
 
 TsPacketSelector::~TsPacketSelector() {
@@ -886,6 +950,10 @@ void TsPacketSelector::inputTsPacket(int64_t clock, TsPacket packet) {
     }
 
 }
+
+const PidBitmap* TsPacketSelector::getPidMap() const {
+    return &pidMap;
+}
 TsPacketSelector::PATDelegator::PATDelegator(AMTContext&ctx, TsPacketSelector& this_) : PsiUpdatedDetector(ctx), this_(this_) {}
 /* virtual */ void TsPacketSelector::PATDelegator::onTableUpdated(int64_t clock, PsiSection section) {
     this_.onPatUpdated(section);
@@ -917,6 +985,18 @@ void TsPacketSelector::initHandlerTable(PidHandlerTable* table) {
     table->addConstant(0x0014, &PsiParserTDT);
 }
 
+void TsPacketSelector::updatePidMap() {
+    pidMap.clear();
+    // 映像ストリーム変更待ちのときは次のテーブルのPIDも必要
+    for (int pid : curHandlerTable->getSetPids()) {
+        pidMap.set(pid);
+    }
+    for (int pid : nextHandlerTable->getSetPids()) {
+        pidMap.set(pid);
+    }
+    pidMap.set(pcrPid);
+}
+
 void TsPacketSelector::onPatUpdated(PsiSection section) {
     if (selectorHandler == NULL) {
         return;
@@ -955,6 +1035,7 @@ void TsPacketSelector::onPatUpdated(PsiSection section) {
             pmtPid = pid;
             curHandlerTable->add(pmtPid, &PsiParserPMT);
         }
+        updatePidMap();
     }
 }
 
@@ -1029,6 +1110,9 @@ void TsPacketSelector::onPmtUpdated(PsiSection section) {
             table->add(captionEs.pid, &captionDelegator);
         }
 
+        pcrPid = pmt.PCR_PID();
+        updatePidMap();
+
         selectorHandler->onPmtUpdated(pmt.PCR_PID());
         if (table == curHandlerTable) {
             selectorHandler->onPidTableChanged(videoEs, audioEs, captionEs);
@@ -1084,6 +1168,7 @@ void TsPacketSelector::swapHandlerTable() {
 
     // PMTを引き継ぐ
     curHandlerTable->add(pmtPid, &PsiParserPMT);
+    updatePidMap();
 }
 
 void TsPacketSelector::ensureAudioDelegators(int numAudios) {
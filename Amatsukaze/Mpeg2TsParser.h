@@ -126,6 +126,17 @@ private:
     int payload_offset;
 };
 
+// ptrから188バイト間隔で同期バイトが連続して合っている数を返す（最大numPackets）
+int CountSyncBytesC(const uint8_t* ptr, int numPackets);
+// lengthバイトの範囲で188バイト間隔にnumPackets個の同期バイトが並ぶ最初の位置を返す
+// 見つからない場合は length - numPackets * 188 + 1 を返す
+int FindSyncOffsetC(const uint8_t* ptr, int length, int numPackets);
+
+// Defined in ComputeKernel.cpp
+bool IsAVX2Available();
+int CountSyncBytesAVX2(const uint8_t* ptr, int numPackets);
+int FindSyncOffsetAVX2(const uint8_t* ptr, int length, int numPackets);
+
 /** @brief TSパケットを切り出す
 * inputTS()を必要回数呼び出して最後にflush()を必ず呼び出すこと。
 * flush()を呼び出さないと内部のバッファに残ったデータが処理されない。
@@ -155,6 +166,9 @@ private:
     AutoBuffer buffer;
     bool syncOK;
 
+    int(*countSyncBytes)(const uint8_t* ptr, int numPackets);
+    int(*findSyncOffset)(const uint8_t* ptr, int length, int numPackets);
+
     // numPacket個分のパケットの同期バイトが合っているかチェック
     bool checkSyncByte(uint8_t* ptr, int numPacket);
 
@@ -522,6 +536,23 @@ private:
     AutoBuffer curSection;
 };
 
+/** @brief PIDの集合（MAX_PID+1ビットのビットマップ） */
+class PidBitmap {
+public:
+    PidBitmap();
+
+    void clear();
+
+    void set(int pid);
+
+    bool test(int pid) const {
+        return ((bits[pid >> 6] >> (pid & 63)) & 1) != 0;
+    }
+
+private:
+    uint64_t bits[(MAX_PID + 1) / 64];
+};
+
 class PidHandlerTable {
 public:
     PidHandlerTable();
@@ -592,6 +623,10 @@ public:
 
     void inputTsPacket(int64_t clock, TsPacket packet);
 
+    // 処理対象のPID（PAT,TDT,PMT,PCR,映像,音声,字幕）
+    // PID Tableが変更されると更新される
+    const PidBitmap* getPidMap() const;
+
 private:
     class PATDelegator : public PsiUpdatedDetector {
         TsPacketSelector& this_;
@@ -651,6 +686,9 @@ private:
     PidHandlerTable *curHandlerTable;
     PidHandlerTable *nextHandlerTable;
 
+    int pcrPid;
+    PidBitmap pidMap;
+
     TsPacketSelectorHandler *selectorHandler;
 
     // 27MHzクロック
@@ -659,6 +697,8 @@ private:
 
     void initHandlerTable(PidHandlerTable* table);
 
+    void updatePidMap();
+
     void onPatUpdated(PsiSection section);
 
     void onPmtUpdated(PsiSection section);
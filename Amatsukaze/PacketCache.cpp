@@ -8,62 +8,227 @@
 
 #include "PacketCache.h"
 
+#include <algorithm>
+
 PacketCache::PacketCache(
     AMTContext& ctx,
     const tstring& filepath,
     const std::vector<int64_t> offsets, // データ数+1要素
     int nLinebit, // キャッシュラインデータ数のビット数
-    int nEntry)	 // 最大キャッシュ保持ライン数
+    int nEntry,	 // 最大キャッシュ保持ライン数
+    int nPrefetch) // 先読みライン数（0で先読みなし）
     : AMTObject(ctx)
     , file_(filepath, _T("rb"))
     , offsets_(offsets)
     , nLinebit_(nLinebit)
-    , nEntry_(nEntry) {
-    int numData = (int)offsets.size() - 1;
-
+    , nEntry_(std::max(1, nEntry))
+    , nPrefetch_(std::max(0, nPrefetch))
+    , lastLineNumber_(-1)
+    , numHits_(0)
+    , numPrefetchHits_(0)
+    , numMisses_(0)
+    , canceled_(false) {
     nLineSize_ = 1 << nLinebit;
     nBaseIndexMask_ = ~(nLineSize_ - 1);
-    cacheTable_.resize((numData + nLineSize_ - 1) >> nLinebit_, nullptr);
+    cacheTable_.resize(getNumLines(), nullptr);
+    lruPos_.resize(cacheTable_.size(), lruList_.end());
+
+    // 全ラインが入る大きさのバッファをまとめて確保
+    size_t maxLineSize = 0;
+    for (int i = 0; i < getNumLines(); ++i) {
+        int64_t offset;
+        size_t size;
+        getLineRange(i, offset, size);
+        maxLineSize = std::max(maxLineSize, size);
+    }
+    int numBuffers = nEntry_ + nPrefetch_;
+    slab_ = std::unique_ptr<uint8_t[]>(new uint8_t[maxLineSize * numBuffers]);
+    for (int i = 0; i < numBuffers; ++i) {
+        freeBuffers_.push_back(slab_.get() + maxLineSize * i);
+    }
+
+    if (nPrefetch_ > 0) {
+        prefetchFile_ = std::unique_ptr<File>(new File(filepath, _T("rb")));
+        start();
+    }
 }
 PacketCache::~PacketCache() {
-    for (int entry : cacheEntries_) {
-        delete[] cacheTable_[entry];
+    if (nPrefetch_ > 0) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            canceled_ = true;
+            cond_.notify_all();
+        }
+        join();
     }
-    cacheTable_.clear();
-    cacheEntries_.clear();
+    ctx.infoF("パケットキャッシュ ヒット: %lld 先読みヒット: %lld ミス: %lld",
+        numHits_, numPrefetchHits_, numMisses_);
 }
 // MemoryChunkは少なくともnEntry回の呼び出しまで有効
 MemoryChunk PacketCache::operator[](int index) {
     int64_t localOffset = offsets_[index] - offsets_[getLineBaseIndex(index)];
     int dataSize = int(offsets_[index + 1] - offsets_[index]);
-    uint8_t* entryPtr = getEntry(getLineNumber(index));
+    int lineNumber = getLineNumber(index);
+    uint8_t* entryPtr = getEntry(lineNumber);
+    if (nPrefetch_ > 0 && lineNumber == lastLineNumber_ + 1) {
+        // 前方に連続アクセスしているので後続ラインを先読み
+        requestPrefetch(lineNumber);
+    }
+    lastLineNumber_ = lineNumber;
     return MemoryChunk(entryPtr + localOffset, dataSize);
 }
 
+/* virtual */ void PacketCache::run() {
+    while (true) {
+        int lineNumber;
+        uint8_t* buffer;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            auto it = prefetchQueue_.end();
+            while (!canceled_) {
+                it = std::find_if(prefetchQueue_.begin(), prefetchQueue_.end(),
+                    [](const PrefetchEntry& e) { return !e.done; });
+                if (it != prefetchQueue_.end()) break;
+                cond_.wait(lock);
+            }
+            if (canceled_) return;
+            lineNumber = it->lineNumber;
+            buffer = it->buffer;
+        }
+        // 処理中のエントリは完了するまで削除されないのでロックなしで読み込める
+        bool failed = false;
+        try {
+            int64_t offset;
+            size_t size;
+            getLineRange(lineNumber, offset, size);
+            prefetchFile_->seek(offset, SEEK_SET);
+            prefetchFile_->read(MemoryChunk(buffer, size));
+        } catch (const Exception&) {
+            // 本読み込みでもう一度読んでエラーはそちらで報告する
+            failed = true;
+        }
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            for (auto& e : prefetchQueue_) {
+                if (e.buffer == buffer) {
+                    e.done = true;
+                    e.failed = failed;
+                }
+            }
+            cond_.notify_all();
+        }
+    }
+}
+
 int PacketCache::getLineNumber(int index) const {
     return index >> nLinebit_;
 }
 int PacketCache::getLineBaseIndex(int index) const {
     return index & nBaseIndexMask_;
 }
+int PacketCache::getNumLines() const {
+    int numData = (int)offsets_.size() - 1;
+    return (numData + nLineSize_ - 1) >> nLinebit_;
+}
+void PacketCache::getLineRange(int lineNumber, int64_t& offset, size_t& size) const {
+    int baseIndex = lineNumber << nLinebit_;
+    int numData = (int)offsets_.size() - 1;
+    offset = offsets_[baseIndex];
+    size = (size_t)(offsets_[std::min(baseIndex + nLineSize_, numData)] - offset);
+}
 uint8_t* PacketCache::getEntry(int lineNumber) {
     uint8_t*& entry = cacheTable_[lineNumber];
-    if (entry == nullptr) {
+    if (entry != nullptr) {
+        ++numHits_;
+        lruList_.splice(lruList_.end(), lruList_, lruPos_[lineNumber]);
+        return entry;
+    }
+    if ((int)lruList_.size() >= nEntry_) {
+        evictLine();
+    }
+    uint8_t* buffer = takePrefetched(lineNumber);
+    if (buffer != nullptr) {
+        ++numPrefetchHits_;
+    } else {
         // キャッシュしていないので読み込む
-        if ((int)cacheEntries_.size() >= nEntry_) {
-            // エントリ数を超える場合は最初に読み込んだキャッシュラインを削除
-            auto& firstEntry = cacheTable_[cacheEntries_.front()];
-            delete[] firstEntry; firstEntry = nullptr;
-            cacheEntries_.pop_front();
+        ++numMisses_;
+        buffer = freeBuffers_.back();
+        freeBuffers_.pop_back();
+        int64_t offset;
+        size_t size;
+        getLineRange(lineNumber, offset, size);
+        try {
+            file_.seek(offset, SEEK_SET);
+            file_.read(MemoryChunk(buffer, size));
+        } catch (...) {
+            freeBuffers_.push_back(buffer);
+            throw;
         }
-        int baseIndex = lineNumber << nLinebit_;
-        int numData = (int)offsets_.size() - 1;
-        int64_t offset = offsets_[baseIndex];
-        int64_t lineDataSize = offsets_[std::min(baseIndex + nLineSize_, numData)] - offset;
-        entry = new uint8_t[(size_t)lineDataSize];
-        cacheEntries_.push_back(lineNumber);
-        file_.seek(offset, SEEK_SET);
-        file_.read(MemoryChunk(entry, (size_t)lineDataSize));
     }
+    entry = buffer;
+    lruPos_[lineNumber] = lruList_.insert(lruList_.end(), lineNumber);
     return entry;
 }
+// 最も長く使われていないラインを削除
+void PacketCache::evictLine() {
+    int lineNumber = lruList_.front();
+    lruList_.pop_front();
+    lruPos_[lineNumber] = lruList_.end();
+    freeBuffers_.push_back(cacheTable_[lineNumber]);
+    cacheTable_[lineNumber] = nullptr;
+}
+// 先読みキューにあれば完了を待ってバッファを受け取る
+uint8_t* PacketCache::takePrefetched(int lineNumber) {
+    if (nPrefetch_ == 0) {
+        return nullptr;
+    }
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto isTarget = [=](const PrefetchEntry& e) { return e.lineNumber == lineNumber; };
+    auto it = std::find_if(prefetchQueue_.begin(), prefetchQueue_.end(), isTarget);
+    if (it == prefetchQueue_.end()) {
+        return nullptr;
+    }
+    while (!it->done) {
+        cond_.wait(lock);
+        it = std::find_if(prefetchQueue_.begin(), prefetchQueue_.end(), isTarget);
+    }
+    uint8_t* buffer = it->buffer;
+    bool failed = it->failed;
+    prefetchQueue_.erase(it);
+    if (failed) {
+        freeBuffers_.push_back(buffer);
+        return nullptr;
+    }
+    return buffer;
+}
+// lineNumberに続くnPrefetchライン分を先読みキューに入れる
+void PacketCache::requestPrefetch(int lineNumber) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    int endLine = std::min(lineNumber + nPrefetch_, getNumLines() - 1);
+    // 範囲外になった読み込み済みエントリは捨てる
+    for (auto it = prefetchQueue_.begin(); it != prefetchQueue_.end();) {
+        if (it->done && (it->lineNumber <= lineNumber || it->lineNumber > endLine)) {
+            freeBuffers_.push_back(it->buffer);
+            it = prefetchQueue_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (int line = lineNumber + 1; line <= endLine; ++line) {
+        if ((int)prefetchQueue_.size() >= nPrefetch_) {
+            break;
+        }
+        if (cacheTable_[line] != nullptr) {
+            continue;
+        }
+        auto it = std::find_if(prefetchQueue_.begin(), prefetchQueue_.end(),
+            [=](const PrefetchEntry& e) { return e.lineNumber == line; });
+        if (it != prefetchQueue_.end()) {
+            continue;
+        }
+        PrefetchEntry e = { line, freeBuffers_.back(), false, false };
+        freeBuffers_.pop_back();
+        prefetchQueue_.push_back(e);
+    }
+    cond_.notify_all();
+}
@@ -9,38 +9,80 @@
 */
 #pragma once
 
+#include <list>
 #include <deque>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
 
 #include "StreamUtils.h"
+#include "ProcessThread.h"
 
-class PacketCache : public AMTObject {
+// ファイル上の可変長データをキャッシュライン単位で読み込んでキャッシュする
+// 追い出しはLRU
+// 前方への連続アクセスを検出すると後続のラインを別スレッドで先読みする
+class PacketCache : public AMTObject, private ThreadBase {
 public:
     PacketCache(
         AMTContext& ctx,
         const tstring& filepath,
         const std::vector<int64_t> offsets, // データ数+1要素
         int nLinebit, // キャッシュラインデータ数のビット数
-        int nEntry)	 // 最大キャッシュ保持ライン数
-;
+        int nEntry,	 // 最大キャッシュ保持ライン数
+        int nPrefetch = 2); // 先読みライン数（0で先読みなし）
     ~PacketCache();
     // MemoryChunkは少なくともnEntry回の呼び出しまで有効
     MemoryChunk operator[](int index);
+
+protected:
+    virtual void run();
+
 private:
+    struct PrefetchEntry {
+        int lineNumber;
+        uint8_t* buffer;
+        bool done;
+        bool failed;
+    };
+
     int nLinebit_;
     int nEntry_;
+    int nPrefetch_;
     int nLineSize_;
     int nBaseIndexMask_;
     File file_;
+    std::unique_ptr<File> prefetchFile_;
     std::vector<int64_t> offsets_;
 
+    // ライン用バッファは最大ラインサイズで(nEntry+nPrefetch)個まとめて確保
+    std::unique_ptr<uint8_t[]> slab_;
+    std::vector<uint8_t*> freeBuffers_;
+
     std::vector<uint8_t*> cacheTable_;
-    std::deque<int> cacheEntries_;
+    // 先頭が最も古い
+    std::list<int> lruList_;
+    std::vector<std::list<int>::iterator> lruPos_;
+
+    int lastLineNumber_;
+
+    // キャッシュにあった/先読み済みだった/ファイルから同期読み込みしたラインへのアクセス数
+    int64_t numHits_;
+    int64_t numPrefetchHits_;
+    int64_t numMisses_;
+
+    // 以下はmtx_で保護
+    std::deque<PrefetchEntry> prefetchQueue_;
+    bool canceled_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
 
     int getLineNumber(int index) const;
     int getLineBaseIndex(int index) const;
+    int getNumLines() const;
+    void getLineRange(int lineNumber, int64_t& offset, size_t& size) const;
     uint8_t* getEntry(int lineNumber);
+    void evictLine();
+    uint8_t* takePrefetched(int lineNumber);
+    void requestPrefetch(int lineNumber);
 };
-
-
-
@@ -0,0 +1,71 @@
+/**
+* Temporal noise reduction row kernels
+* Copyright (c) 2017-2019 Nekopanda
+*
+* This software is released under the MIT License.
+* http://opensource.org/licenses/mit-license.php
+*/
+
+// AVXなしのCPUでも動くようにComputeKernel.cppとは別にコンパイルする
+#include "TemporalNRKernel.h"
+
+#include <stdlib.h>
+
+enum { TNR_MAX_NFRAMES = 128 };
+
+// 各参照フレームの差分判定は1回だけ行って重み付けと加算で使い回す
+template <typename T>
+static void TemporalNRRowCT(const T* const* srcY, const T* const* srcU, const T* const* srcV,
+    T* dstY, T* dstU, T* dstV, int x, int width, int nframes, int mid, int thresh, const float* kernel) {
+    const bool cout = (dstU != NULL);
+    bool match[TNR_MAX_NFRAMES];
+    for (; x < width; ++x) {
+        int cx = x >> 1;
+
+        T Y = srcY[mid][x];
+        T U = srcU[mid][cx];
+        T V = srcV[mid][cx];
+
+        float sumKernel = 0.0f;
+        for (int i = 0; i < nframes; ++i) {
+            int diff =
+                abs((int)Y - (int)srcY[i][x]) +
+                abs((int)U - (int)srcU[i][cx]) +
+                abs((int)V - (int)srcV[i][cx]);
+            match[i] = (diff <= thresh);
+            if (match[i]) {
+                sumKernel += kernel[i];
+            }
+        }
+
+        float factor = 1.f / sumKernel;
+
+        float dY = 0.5f;
+        float dU = 0.5f;
+        float dV = 0.5f;
+        for (int i = 0; i < nframes; ++i) {
+            if (match[i]) {
+                float coef = kernel[i] * factor;
+                dY += coef * srcY[i][x];
+                dU += coef * srcU[i][cx];
+                dV += coef * srcV[i][cx];
+            }
+        }
+
+        dstY[x] = (T)dY;
+
+        if (cout && (x & 1) == 0) {
+            dstU[cx] = (T)dU;
+            dstV[cx] = (T)dV;
+        }
+    }
+}
+
+void TemporalNRRowC(const uint8_t* const* srcY, const uint8_t* const* srcU, const uint8_t* const* srcV,
+    uint8_t* dstY, uint8_t* dstU, uint8_t* dstV, int x, int width, int nframes, int mid, int thresh, const float* kernel) {
+    TemporalNRRowCT(srcY, srcU, srcV, dstY, dstU, dstV, x, width, nframes, mid, thresh, kernel);
+}
+void TemporalNRRowC(const uint16_t* const* srcY, const uint16_t* const* srcU, const uint16_t* const* srcV,
+    uint16_t* dstY, uint16_t* dstU, uint16_t* dstV, int x, int width, int nframes, int mid, int thresh, const float* kernel) {
+    TemporalNRRowCT(srcY, srcU, srcV, dstY, dstU, dstV, x, width, nframes, mid, thresh, kernel);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+/**
+* Temporal noise reduction row kernels
+* Copyright (c) 2017-2019 Nekopanda
+*
+* This software is released under the MIT License.
+* http://opensource.org/licenses/mit-license.php
+*/
+
+#include <stdint.h>
+
+// TemporalNRFilter::filterKernelの1行分と同じ計算
+// （TemporalNRFilterはビルド対象外なので今はtest_tnrだけが使う）
+// srcY,srcU,srcVは各参照フレームの行先頭 dstU,dstVはこの行で色差を出力しない場合はNULL
+//
+// スカラー版とAVX2版は浮動小数の演算順序を同じにしてあるので結果は一致する
+// ただし積和がFMAに縮約されると一致しなくなるので、どちらも縮約なしでコンパイルすること
+// （Makefileで-ffp-contract=offを指定している）
+
+// xから行末までをスカラーで計算する（TemporalNRKernel.cpp）
+void TemporalNRRowC(const uint8_t* const* srcY, const uint8_t* const* srcU, const uint8_t* const* srcV,
+    uint8_t* dstY, uint8_t* dstU, uint8_t* dstV, int x, int width, int nframes, int mid, int thresh, const float* kernel);
+void TemporalNRRowC(const uint16_t* const* srcY, const uint16_t* const* srcU, const uint16_t* const* srcV,
+    uint16_t* dstY, uint16_t* dstU, uint16_t* dstV, int x, int width, int nframes, int mid, int thresh, const float* kernel);
+
+// Defined in ComputeKernel.cpp
+bool IsAVX2Available();
+// 先頭から8画素ずつAVX2で計算して処理した画素数を返す（残りはTemporalNRRowCで計算する）
+int TemporalNRRowAVX2(const uint8_t* const* srcY, const uint8_t* const* srcU, const uint8_t* const* srcV,
+    uint8_t* dstY, uint8_t* dstU, uint8_t* dstV, int width, int nframes, int mid, int thresh, const float* kernel);
+int TemporalNRRowAVX2(const uint16_t* const* srcY, const uint16_t* const* srcU, const uint16_t* const* srcV,
+    uint16_t* dstY, uint16_t* dstU, uint16_t* dstV, int width, int nframes, int mid, int thresh, const float* kernel);
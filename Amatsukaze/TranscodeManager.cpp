@@ -21,13 +21,19 @@ AMTSplitter::AMTSplitter(AMTContext& ctx, const ConfigWrapper& setting)
     , audioStreamType_(-1)
     , audioFileSize_(0)
     , waveFileSize_(0)
-    , srcFileSize_(0) {
+    , srcFileSize_(0)
+    , firstVideoPTS_(-1) {
     psWriter.setHandler(&writeHandler);
 }
 
 StreamReformInfo AMTSplitter::split() {
     readAll();
 
+    if (setting_.isLazyWave()) {
+        // PCMは書いていないので代わりにデコード用のインデックスを書く
+        WriteWaveIndex(waveFile_, setting_.getAudioFilePath(), audioFrameList_);
+    }
+
     // for debug
     printInteraceCount();
 
@@ -62,16 +68,22 @@ int64_t AMTSplitter::StreamFileWriteHandler::getTotalSize() const {
 }
 
 void AMTSplitter::readAll() {
-    enum { BUFSIZE = 4 * 1024 * 1024 };
-    auto buffer_ptr = std::unique_ptr<uint8_t[]>(new uint8_t[BUFSIZE]);
-    MemoryChunk buffer(buffer_ptr.get(), BUFSIZE);
     File srcfile(setting_.getSrcFilePath(), _T("rb"));
     srcFileSize_ = srcfile.size();
-    size_t readBytes;
-    do {
-        readBytes = srcfile.read(buffer);
-        inputTsData(MemoryChunk(buffer.data, readBytes));
-    } while (readBytes == buffer.length);
+    AsyncFileReader reader(srcfile, 4 * 1024 * 1024, 2, setting_.isMmapInput());
+    MemoryChunk buffer;
+    // 並列TS解析しない場合もAACのデコード（wave出力用）は音声ストリーム毎のスレッドで行う
+    startParallel(!setting_.isParallelTsAnalysis());
+    try {
+        do {
+            buffer = reader.read();
+            inputTsData(buffer);
+        } while (buffer.length == reader.getBlockSize());
+    } catch (const Exception&) {
+        joinParallel();
+        throw;
+    }
+    finishParallel();
 }
 
 /* static */ bool AMTSplitter::CheckPullDown(PICTURE_TYPE p0, PICTURE_TYPE p1) {
@@ -174,6 +186,9 @@ void AMTSplitter::printInteraceCount() {
     int64_t clock,
     const std::vector<VideoFrameInfo>& frames,
     PESPacket packet) {
+    if (videoFrameList_.size() == 0 && frames.size() > 0) {
+        firstVideoPTS_ = frames[0].PTS;
+    }
     for (const VideoFrameInfo& frame : frames) {
         videoFrameList_.push_back(frame);
         videoFrameList_.back().fileOffset = writeHandler.getTotalSize();
@@ -226,7 +241,8 @@ void AMTSplitter::printInteraceCount() {
         info.fileOffset = audioFileSize_;
         info.waveOffset = waveFileSize_;
         audioFile_.write(MemoryChunk(frame.codedData, frame.codedDataSize));
-        if (frame.decodedDataSize > 0) {
+        // --lazy-waveの場合はオフセットだけ進めて後でAACからデコードする
+        if (frame.decodedDataSize > 0 && !setting_.isLazyWave()) {
             waveFile_.write(MemoryChunk((uint8_t*)frame.decodedData, frame.decodedDataSize));
         }
         audioFileSize_ += frame.codedDataSize;
@@ -261,7 +277,8 @@ void AMTSplitter::printInteraceCount() {
 
 /* virtual */ DRCSOutInfo AMTSplitter::getDRCSOutPath(int64_t PTS, const std::string& md5) {
     DRCSOutInfo info;
-    info.elapsed = (videoFrameList_.size() > 0) ? (double)(PTS - videoFrameList_[0].PTS) : -1.0;
+    int64_t firstPTS = firstVideoPTS_;
+    info.elapsed = (firstPTS != -1) ? (double)(PTS - firstPTS) : -1.0;
     info.filename = setting_.getDRCSOutPath(md5);
     return info;
 }
@@ -273,14 +290,20 @@ void AMTSplitter::printInteraceCount() {
     TsSplitter::onPidTableChanged(video, audio, caption);
 
     ASSERT(audio.size() > 0);
-    videoStreamType_ = video.stype;
-    audioStreamType_ = audio[0].stype;
-
-    StreamEvent ev = StreamEvent();
-    ev.type = PID_TABLE_CHANGED;
-    ev.numAudio = (int)audio.size();
-    ev.frameIdx = (int)videoFrameList_.size();
-    streamEventList_.push_back(ev);
+    int videoStreamType = video.stype;
+    int audioStreamType = audio[0].stype;
+    int numAudio = (int)audio.size();
+
+    runInOrder([=]() {
+        videoStreamType_ = videoStreamType;
+        audioStreamType_ = audioStreamType;
+
+        StreamEvent ev = StreamEvent();
+        ev.type = PID_TABLE_CHANGED;
+        ev.numAudio = numAudio;
+        ev.frameIdx = (int)videoFrameList_.size();
+        streamEventList_.push_back(ev);
+    });
 }
 
 /* virtual */ void AMTSplitter::onTime(int64_t clock, JSTTime time) {
@@ -333,7 +356,7 @@ tstring EncoderArgumentGenerator::GenEncoderOptions(
     tstring timecodepath,
     int vfrTimingFps,
     EncodeFileKey key, int pass, int serviceID,
-    const EncoderOptionInfo& eoInfo) {
+    const EncoderOptionInfo& eoInfo, int chunk) {
     VIDEO_STREAM_FORMAT srcFormat = reformInfo_.getVideoStreamFormat();
     double srcBitrate = getSourceBitrate(key.video);
     return makeEncoderArgs(
@@ -347,7 +370,7 @@ tstring EncoderArgumentGenerator::GenEncoderOptions(
         timecodepath,
         vfrTimingFps,
         setting_.getFormat(),
-        setting_.getEncVideoFilePath(key));
+        (chunk >= 0) ? setting_.getEncVideoChunkFilePath(key, chunk) : setting_.getEncVideoFilePath(key));
 }
 
 // src, target
@@ -414,6 +437,278 @@ double EncoderArgumentGenerator::getSourceBitrate(int fileId) const {
     return bitrateZones;
 }
 
+std::vector<EncoderZone> MakeEncodeChunks(int numFrames, const std::vector<int>& sceneChanges, int numChunks) {
+    int chunkFrames = numFrames / std::max(1, numChunks);
+    std::vector<int> bounds(1, 0);
+    for (int i = 1; i < numChunks; ++i) {
+        int target = (int)((int64_t)numFrames * i / numChunks);
+        int bound = target;
+        // 区間長の1/4以内で最も近いシーンチェンジ
+        int bestDiff = chunkFrames / 4 + 1;
+        auto it = std::lower_bound(sceneChanges.begin(), sceneChanges.end(), target);
+        if (it != sceneChanges.end() && *it - target < bestDiff) {
+            bound = *it;
+            bestDiff = *it - target;
+        }
+        if (it != sceneChanges.begin() && target - *(it - 1) < bestDiff) {
+            bound = *(it - 1);
+        }
+        // 短すぎる区間は作らない
+        if (bound - bounds.back() >= chunkFrames / 2 && numFrames - bound >= chunkFrames / 2) {
+            bounds.push_back(bound);
+        }
+    }
+    bounds.push_back(numFrames);
+    std::vector<EncoderZone> chunks;
+    for (int i = 1; i < (int)bounds.size(); ++i) {
+        EncoderZone chunk = { bounds[i - 1], bounds[i] };
+        chunks.push_back(chunk);
+    }
+    return chunks;
+}
+
+std::vector<BitrateZone> SliceBitrateZones(const std::vector<BitrateZone>& zones, int start, int end) {
+    std::vector<BitrateZone> sliced;
+    for (const auto& zone : zones) {
+        int zoneStart = std::max(zone.startFrame, start);
+        int zoneEnd = std::min(zone.endFrame, end);
+        if (zoneStart < zoneEnd) {
+            BitrateZone newZone = zone;
+            newZone.startFrame = zoneStart - start;
+            newZone.endFrame = zoneEnd - start;
+            sliced.push_back(newZone);
+        }
+    }
+    return sliced;
+}
+
+std::vector<uint64_t> SplitAffinityMask(uint64_t mask, int numCPUs, int numParts) {
+    std::vector<int> cpus;
+    if (mask == 0) {
+        if (numCPUs <= 0) {
+            // 制限なし
+            return std::vector<uint64_t>(std::max(1, numParts), 0);
+        }
+        int numProcs = std::min(GetProcessorCount(), (int)sizeof(mask) * 8);
+        for (int i = 0; i < numProcs; ++i) {
+            cpus.push_back(i);
+        }
+    } else {
+        for (int i = 0; i < (int)sizeof(mask) * 8; ++i) {
+            if (mask & (1ULL << i)) {
+                cpus.push_back(i);
+            }
+        }
+    }
+    if (numCPUs > 0 && (int)cpus.size() > numCPUs) {
+        cpus.resize(numCPUs);
+    }
+    // 1つのエンコードに最低1CPUは割り当てる
+    numParts = std::max(1, std::min(numParts, (int)cpus.size()));
+    std::vector<uint64_t> masks(numParts, 0);
+    for (int i = 0; i < (int)cpus.size(); ++i) {
+        masks[i * numParts / (int)cpus.size()] |= 1ULL << cpus[i];
+    }
+    return masks;
+}
+
+ParallelEncodeScheduler::ParallelEncodeScheduler(AMTContext& ctx,
+    const ResourceAllocation& allocation, int numParallel, int numCPUs)
+    : AMTObject(ctx)
+    , task(nullptr)
+    , numTasks(0)
+    , nextTask(0) {
+    for (uint64_t mask : SplitAffinityMask(allocation.mask, numCPUs, numParallel)) {
+        ResourceAllocation slot = allocation;
+        slot.mask = mask;
+        slots.push_back(slot);
+    }
+}
+
+int ParallelEncodeScheduler::getNumParallel() const {
+    return (int)slots.size();
+}
+
+void ParallelEncodeScheduler::run(int numTasks, const EncodeTask& task) {
+    this->task = &task;
+    this->numTasks = numTasks;
+    nextTask = 0;
+    error = nullptr;
+    {
+        std::vector<std::unique_ptr<Worker>> workers;
+        try {
+            for (int i = 0; i < std::min((int)slots.size(), numTasks); ++i) {
+                workers.emplace_back(new Worker(*this, slots[i]));
+            }
+        } catch (...) {
+            // 起動済みのワーカーは実行中のタスクだけ終わらせる
+            setError(std::current_exception());
+        }
+        // ここでワーカーの終了を待つ
+    }
+    this->task = nullptr;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+int ParallelEncodeScheduler::getNextTask() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (nextTask >= numTasks) {
+        return -1;
+    }
+    return nextTask++;
+}
+
+void ParallelEncodeScheduler::setError(std::exception_ptr e) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!error) {
+        error = e;
+    }
+    nextTask = numTasks;
+}
+
+ParallelEncodeScheduler::Worker::Worker(ParallelEncodeScheduler& parent, const ResourceAllocation& allocation)
+    : parent(parent)
+    , rm(parent.ctx, allocation) {
+    start();
+}
+
+ParallelEncodeScheduler::Worker::~Worker() {
+    join();
+}
+
+/* virtual */ void ParallelEncodeScheduler::Worker::run() {
+    while (true) {
+        int index = parent.getNextTask();
+        if (index < 0) return;
+        try {
+            (*parent.task)(index, rm);
+        } catch (...) {
+            parent.setError(std::current_exception());
+            return;
+        }
+    }
+}
+
+TaskGraph::TaskGraph(AMTContext& ctx, int numThreads)
+    : AMTObject(ctx)
+    , numThreads(std::max(1, numThreads))
+    , numPending(0)
+    , canceled(false) {}
+
+TaskGraph::~TaskGraph() {
+    cancel();
+    workers.clear();
+}
+
+int TaskGraph::add(const Task& task, const std::vector<int>& deps) {
+    Node node = { task, deps, false, false, false };
+    nodes.push_back(node);
+    ++numPending;
+    return (int)nodes.size() - 1;
+}
+
+int TaskGraph::addExternal() {
+    Node node = { Task(), std::vector<int>(), true, true, false };
+    nodes.push_back(node);
+    return (int)nodes.size() - 1;
+}
+
+void TaskGraph::start() {
+    try {
+        for (int i = 0; i < numThreads; ++i) {
+            workers.emplace_back(new Worker(*this));
+        }
+    } catch (...) {
+        cancel();
+        throw;
+    }
+}
+
+void TaskGraph::complete(int id) {
+    std::lock_guard<std::mutex> lock(mtx);
+    nodes[id].done = true;
+    cond.notify_all();
+}
+
+void TaskGraph::cancel() {
+    std::lock_guard<std::mutex> lock(mtx);
+    canceled = true;
+    cond.notify_all();
+}
+
+void TaskGraph::wait() {
+    workers.clear();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void TaskGraph::checkError() {
+    std::exception_ptr e;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        e = error;
+    }
+    if (e) {
+        std::rethrow_exception(e);
+    }
+}
+
+// 実行可能なタスクがなければ待つ。もう実行するタスクがなければ-1
+int TaskGraph::takeTask() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!canceled && numPending > 0) {
+        for (int i = 0; i < (int)nodes.size(); ++i) {
+            auto& node = nodes[i];
+            if (node.started) continue;
+            bool ready = std::all_of(node.deps.begin(), node.deps.end(),
+                [&](int dep) { return nodes[dep].done; });
+            if (ready) {
+                node.started = true;
+                --numPending;
+                return i;
+            }
+        }
+        cond.wait(lock);
+    }
+    return -1;
+}
+
+void TaskGraph::setError(std::exception_ptr e) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!error) {
+        error = e;
+    }
+    canceled = true;
+    cond.notify_all();
+}
+
+TaskGraph::Worker::Worker(TaskGraph& parent)
+    : parent(parent) {
+    start();
+}
+
+TaskGraph::Worker::~Worker() {
+    join();
+}
+
+/* virtual */ void TaskGraph::Worker::run() {
+    while (true) {
+        int id = parent.takeTask();
+        if (id < 0) return;
+        try {
+            // 実行中はノードは変更されないのでロックなしで参照できる
+            parent.nodes[id].task();
+        } catch (...) {
+            parent.setError(std::current_exception());
+            return;
+        }
+        parent.complete(id);
+    }
+}
+
 // ページヒープが機能しているかテスト
 void DoBadThing() {
 #ifdef _WIN32
@@ -525,7 +820,8 @@ void DoBadThing() {
             fmt.videoFormat, fmt.audioFormat[0],
             reformInfo.getFilterSourceFrames(videoFileIndex),
             reformInfo.getFilterSourceAudioFrames(videoFileIndex),
-            setting.getDecoderSetting());
+            setting.getDecoderSetting(),
+            setting.getTmpAMTSeekIndexPath(videoFileIndex));
     }
 
     // ロゴ・CM解析
@@ -597,16 +893,14 @@ void DoBadThing() {
 
     std::vector<EncodeFileOutput> outFileInfo(keys.size());
 
-    ctx.info("[チャプター生成]");
-    for (int i = 0; i < (int)keys.size(); ++i) {
+    auto makeChapterFile = [&](int i) {
         auto key = keys[i];
         if (chapterMakers[key.video]) {
             chapterMakers[key.video]->exec(key);
         }
-    }
+    };
 
-    ctx.info("[字幕ファイル生成]");
-    for (int i = 0; i < (int)keys.size(); ++i) {
+    auto makeSubtitleFiles = [&](int i) {
         auto key = keys[i];
         CaptionASSFormatter formatterASS(ctx);
         CaptionSRTFormatter formatterSRT(ctx);
@@ -631,43 +925,39 @@ void DoBadThing() {
                 file.write(MemoryChunk((uint8_t*)text.data(), text.size()));
             }
         }
-    }
-    ctx.infoF("字幕ファイル生成完了: %.2f秒", sw.getAndReset());
+    };
 
-    if (setting.isEncodeAudio()) {
-        ctx.info("[音声エンコード]");
-        for (int i = 0; i < (int)keys.size(); ++i) {
-            auto key = keys[i];
-            auto outpath = setting.getIntAudioFilePath(key, 0, setting.getAudioEncoder());
-            auto args = makeAudioEncoderArgs(
-                setting.getAudioEncoder(),
-                setting.getAudioEncoderPath(),
-                setting.getAudioEncoderOptions(),
-                setting.getAudioBitrateInKbps(),
-                outpath);
-            auto format = reformInfo.getFormat(key);
-            auto audioFrames = reformInfo.getWaveInput(reformInfo.getEncodeFile(key).audioFrames[0]);
-            EncodeAudio(ctx, args, setting.getWaveFilePath(), format.audioFormat[0], audioFrames);
-        }
-    }
+    auto encodeAudioFile = [&](int i) {
+        auto key = keys[i];
+        auto outpath = setting.getIntAudioFilePath(key, 0, setting.getAudioEncoder());
+        auto args = makeAudioEncoderArgs(
+            setting.getAudioEncoder(),
+            setting.getAudioEncoderPath(),
+            setting.getAudioEncoderOptions(),
+            setting.getAudioBitrateInKbps(),
+            outpath);
+        auto format = reformInfo.getFormat(key);
+        auto audioFrames = reformInfo.getWaveInput(reformInfo.getEncodeFile(key).audioFrames[0]);
+        EncodeAudio(ctx, args, setting.getWaveFilePath(), format.audioFormat[0], audioFrames);
+    };
 
     auto argGen = std::unique_ptr<EncoderArgumentGenerator>(new EncoderArgumentGenerator(setting, reformInfo));
 
-    sw.start();
-    for (int i = 0; i < (int)keys.size(); ++i) {
+    auto encodeFile = [&](int i, const ResourceManger& encodeRm) {
         auto key = keys[i];
         auto& fileOut = outFileInfo[i];
         const CMAnalyze* cma = cmanalyze[key.video].get();
 
         AMTFilterSource filterSource(ctx, setting, reformInfo,
-            cma->getZones(), cma->getLogoFrameCmd(), key, rm);
+            cma->getZones(), cma->getLogoFrameCmd(), key, encodeRm);
 
         try {
             PClip filterClip = filterSource.getClip();
             IScriptEnvironment2* env = filterSource.getEnv();
             auto encoderZones = filterSource.getZones();
             auto& outfmt = filterSource.getFormat();
-            auto& outvi = filterClip->GetVideoInfo();
+            // 分割エンコードではクリップを解放するのでコピーしておく
+            const VideoInfo outvi = filterClip->GetVideoInfo();
             auto& timeCodes = filterSource.getTimeCodes();
 
             ctx.infoF("[エンコード開始] %d/%d %s", i + 1, (int)keys.size(), CMTypeToString(key.cm));
@@ -702,6 +992,61 @@ void DoBadThing() {
 
             auto bitrateZones = MakeBitrateZones(timeCodes, encoderZones, setting, eoInfo, outvi);
             auto vfrBitrateScale = AdjustVFRBitrate(timeCodes, outvi.fps_numerator, outvi.fps_denominator);
+            // x264, x265, SVT-AV1のときはdisablePowerThrottoling=trueとする
+            // QSV/NV/VCEEncではプロセス内で自動的に最適なように設定されるため不要
+            const bool disablePowerThrottoling = (setting.getEncoder() == ENCODER_X264 || setting.getEncoder() == ENCODER_X265 || setting.getEncoder() == ENCODER_SVTAV1);
+
+            if (setting.getNumEncodeChunks() > 1) {
+                if (!disablePowerThrottoling || setting.isTwoPass() || timeCodes.size() > 0 || eoInfo.afsTimecode ||
+                    outvi.num_frames < setting.getNumEncodeChunks() * MIN_ENCODE_CHUNK_FRAMES) {
+                    ctx.info("分割エンコードできない条件なので通常のエンコードを行います");
+                } else {
+                    auto chunks = MakeEncodeChunks(outvi.num_frames,
+                        filterSource.getOutFrames(cma->getSceneChanges()), setting.getNumEncodeChunks());
+                    ctx.infoF("分割エンコード: %d区間 (シーンチェンジ %d箇所)",
+                        (int)chunks.size(), (int)cma->getSceneChanges().size());
+                    std::vector<tstring> chunkPaths;
+                    for (int c = 0; c < (int)chunks.size(); ++c) {
+                        chunkPaths.push_back(setting.getEncVideoChunkFilePath(key, c));
+                    }
+                    // 区間ごとにフィルタグラフを作り直すので、メインのグラフは解放してメモリを空ける
+                    filterClip = nullptr;
+                    env = nullptr;
+                    filterSource.releaseClip();
+                    // このファイルに割り当てられたCPUを区間ごとに分ける
+                    ParallelEncodeScheduler scheduler(ctx, filterSource.getEncodeResource(), (int)chunks.size(), 0);
+                    scheduler.run((int)chunks.size(), [&](int c, const ResourceManger& chunkRm) {
+                        auto res = chunkRm.wait(HOST_CMD_Encode);
+                        SetCPUAffinity(res.group, res.mask);
+                        const auto& chunk = chunks[c];
+                        int numChunkFrames = chunk.endFrame - chunk.startFrame;
+                        std::vector<tstring> chunkArgs(1, argGen->GenEncoderOptions(
+                            numChunkFrames, outfmt,
+                            SliceBitrateZones(bitrateZones, chunk.startFrame, chunk.endFrame), vfrBitrateScale,
+                            fileOut.timecode, fileOut.vfrTimingFps, key, -1, serviceId, eoInfo, c));
+                        // 区間ごとに別のAvisynth環境でフィルタを実行する
+                        auto chunkEnv = make_unique_ptr((IScriptEnvironment2*)nullptr);
+                        PClip chunkClip = filterSource.createClip(chunkEnv);
+                        try {
+                            AVSValue trimArgs[] = { chunkClip, chunk.startFrame, -numChunkFrames };
+                            chunkClip = chunkEnv->Invoke("Trim", AVSValue(trimArgs, 3)).AsClip();
+                            ctx.infoF("[区間エンコード開始] %d/%d フレーム%d-%d",
+                                c + 1, (int)chunks.size(), chunk.startFrame, chunk.endFrame - 1);
+                            AMTFilterVideoEncoder encoder(ctx, std::max(4, setting.getNumEncodeBufferFrames()));
+                            encoder.encode(chunkClip, outfmt,
+                                timeCodes, chunkArgs, disablePowerThrottoling, chunkEnv.get());
+                        } catch (const AvisynthError& avserror) {
+                            THROWF(AviSynthException, "%s", avserror.msg);
+                        }
+                    });
+                    ConcatEncodedChunks(ctx, setting.getEncoder(), chunkPaths, setting.getEncVideoFilePath(key));
+                    for (const auto& path : chunkPaths) {
+                        removeT(path.c_str());
+                    }
+                    return;
+                }
+            }
+
             // VFRフレームタイミングが120fpsか
             std::vector<tstring> encoderArgs;
             for (int i = 0; i < (int)pass.size(); ++i) {
@@ -711,35 +1056,116 @@ void DoBadThing() {
                         outfmt, bitrateZones, vfrBitrateScale,
                         fileOut.timecode, fileOut.vfrTimingFps, key, pass[i], serviceId, eoInfo));
             }
-            // x264, x265, SVT-AV1のときはdisablePowerThrottoling=trueとする
-            // QSV/NV/VCEEncではプロセス内で自動的に最適なように設定されるため不要
-            const bool disablePowerThrottoling = (setting.getEncoder() == ENCODER_X264 || setting.getEncoder() == ENCODER_X265 || setting.getEncoder() == ENCODER_SVTAV1);
             AMTFilterVideoEncoder encoder(ctx, std::max(4, setting.getNumEncodeBufferFrames()));
             encoder.encode(filterClip, outfmt,
                 timeCodes, encoderArgs, disablePowerThrottoling, env);
         } catch (const AvisynthError& avserror) {
             THROWF(AviSynthException, "%s", avserror.msg);
         }
-    }
-    ctx.infoF("エンコード完了: %.2f秒", sw.getAndReset());
+    };
 
-    argGen = nullptr;
+    // onEncodedはファイルごとのエンコード完了時に呼ばれる（並列エンコード時はワーカースレッドから）
+    auto encodeAllFiles = [&](const std::function<void(int)>& onEncoded) {
+        const int numParallelEncodes = std::min(setting.getNumParallelEncodes(), (int)keys.size());
+        if (numParallelEncodes > 1) {
+            // エンコード用リソースをまとめて確保して各エンコードに分配する
+            auto res = rm.wait(HOST_CMD_Encode);
+            ParallelEncodeScheduler scheduler(ctx, res, numParallelEncodes, setting.getNumEncodeCPUs());
+            ctx.infoF("並列エンコード: %d並列 (%dファイル)", scheduler.getNumParallel(), (int)keys.size());
+            scheduler.run((int)keys.size(), [&](int i, const ResourceManger& encodeRm) {
+                encodeFile(i, encodeRm);
+                onEncoded(i);
+            });
+        } else {
+            for (int i = 0; i < (int)keys.size(); ++i) {
+                encodeFile(i, rm);
+                onEncoded(i);
+            }
+        }
+    };
 
-    rm.wait(HOST_CMD_Mux);
-    sw.start();
-    int64_t totalOutSize = 0;
-    auto muxer = std::unique_ptr<AMTMuxder>(new AMTMuxder(ctx, setting, reformInfo));
-    for (int i = 0; i < (int)keys.size(); ++i) {
+    auto muxFile = [&](int i, AMTMuxder& muxer) {
         auto key = keys[i];
-
         ctx.infoF("[Mux開始] %d/%d %s", i + 1, (int)keys.size(), CMTypeToString(key.cm));
-        muxer->mux(key, eoInfo, nicoOK, outFileInfo[i]);
+        muxer.mux(key, eoInfo, nicoOK, outFileInfo[i]);
+    };
 
+    if (setting.isOverlapStages()) {
+        // チャプター・字幕・音声エンコードは映像エンコードと並行して実行し、
+        // 各ファイルのMuxはそのファイルの全ての入力が揃った時点で開始する
+        ctx.info("[エンコード] チャプター・字幕・音声・Muxを並行実行");
+        TaskGraph graph(ctx, std::max(2, setting.getNumParallelEncodes()));
+        std::vector<int> videoTasks(keys.size());
+        for (int i = 0; i < (int)keys.size(); ++i) {
+            std::vector<int> deps;
+            deps.push_back(graph.add([&, i]() { makeChapterFile(i); }));
+            deps.push_back(graph.add([&, i]() { makeSubtitleFiles(i); }));
+            if (setting.isEncodeAudio()) {
+                deps.push_back(graph.add([&, i]() { encodeAudioFile(i); }));
+            }
+            videoTasks[i] = graph.addExternal();
+            deps.push_back(videoTasks[i]);
+            graph.add([&, i]() {
+                // 映像エンコード中のMuxはエンコードに割り当てられたリソースの範囲で実行する
+                // （ホストのフェーズはプロセスに1つなので途中でMuxに切り替えない）
+                // Muxは並行して走ることがあるのでファイルごとに作る
+                AMTMuxder muxer(ctx, setting, reformInfo);
+                muxFile(i, muxer);
+            }, deps);
+        }
+        graph.start();
+        sw.start();
+        encodeAllFiles([&](int i) {
+            graph.complete(videoTasks[i]);
+            // 並行タスクが失敗していたら残りのファイルはエンコードしない
+            graph.checkError();
+        });
+        ctx.infoF("エンコード完了: %.2f秒", sw.getAndReset());
+        argGen = nullptr;
+
+        // 全ての映像エンコードが終わってからMuxフェーズに移行する
+        rm.wait(HOST_CMD_Mux);
+        graph.wait();
+        ctx.infoF("Mux完了: %.2f秒", sw.getAndReset());
+    } else {
+        ctx.info("[チャプター生成]");
+        for (int i = 0; i < (int)keys.size(); ++i) {
+            makeChapterFile(i);
+        }
+
+        ctx.info("[字幕ファイル生成]");
+        for (int i = 0; i < (int)keys.size(); ++i) {
+            makeSubtitleFiles(i);
+        }
+        ctx.infoF("字幕ファイル生成完了: %.2f秒", sw.getAndReset());
+
+        if (setting.isEncodeAudio()) {
+            ctx.info("[音声エンコード]");
+            for (int i = 0; i < (int)keys.size(); ++i) {
+                encodeAudioFile(i);
+            }
+        }
+
+        sw.start();
+        encodeAllFiles([](int i) {});
+        ctx.infoF("エンコード完了: %.2f秒", sw.getAndReset());
+
+        argGen = nullptr;
+
+        rm.wait(HOST_CMD_Mux);
+        sw.start();
+        auto muxer = std::unique_ptr<AMTMuxder>(new AMTMuxder(ctx, setting, reformInfo));
+        for (int i = 0; i < (int)keys.size(); ++i) {
+            muxFile(i, *muxer);
+        }
+        ctx.infoF("Mux完了: %.2f秒", sw.getAndReset());
+    }
+
+    int64_t totalOutSize = 0;
+    for (int i = 0; i < (int)keys.size(); ++i) {
         totalOutSize += outFileInfo[i].fileSize;
     }
-    ctx.infoF("Mux完了: %.2f秒", sw.getAndReset());
 
-    muxer = nullptr;
     // 出力結果を表示
     reformInfo.printOutputMapping([&](EncodeFileKey key) {
         const auto& file = reformInfo.getEncodeFile(key);
@@ -836,15 +1262,13 @@ DrcsSearchSplitter::DrcsSearchSplitter(AMTContext& ctx, const ConfigWrapper& set
     , setting_(setting) {}
 
 void DrcsSearchSplitter::readAll() {
-    enum { BUFSIZE = 4 * 1024 * 1024 };
-    auto buffer_ptr = std::unique_ptr<uint8_t[]>(new uint8_t[BUFSIZE]);
-    MemoryChunk buffer(buffer_ptr.get(), BUFSIZE);
     File srcfile(setting_.getSrcFilePath(), _T("rb"));
-    size_t readBytes;
+    AsyncFileReader reader(srcfile, 4 * 1024 * 1024, 2, setting_.isMmapInput());
+    MemoryChunk buffer;
     do {
-        readBytes = srcfile.read(buffer);
-        inputTsData(MemoryChunk(buffer.data, readBytes));
-    } while (readBytes == buffer.length);
+        buffer = reader.read();
+        inputTsData(buffer);
+    } while (buffer.length == reader.getBlockSize());
 }
 
 // TsSplitter仮想関数 //
@@ -13,8 +13,13 @@
 #include <memory>
 #include <limits>
 #include <smmintrin.h>
+#include <functional>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
 
 #include "TsSplitter.h"
+#include "AsyncFileReader.h"
 #include "Encoder.h"
 #include "Muxer.h"
 #include "StreamReform.h"
@@ -71,6 +76,8 @@ protected:
     int64_t audioFileSize_;
     int64_t waveFileSize_;
     int64_t srcFileSize_;
+    // DRCS外字の時刻表示用（並列解析時は反映スレッドで更新され、字幕パースは先行する反映を待ってから読む）
+    std::atomic<int64_t> firstVideoPTS_;
 
     // データ
     std::vector<FileVideoFrameInfo> videoFrameList_;
@@ -138,7 +145,7 @@ public:
         tstring timecodepath,
         int vfrTimingFps,
         EncodeFileKey key, int pass, int serviceID,
-        const EncoderOptionInfo& eoInfo);
+        const EncoderOptionInfo& eoInfo, int chunk = -1);
 
     // src, target
     std::pair<double, double> printBitrate(AMTContext& ctx, EncodeFileKey key) const;
@@ -157,6 +164,121 @@ std::vector<BitrateZone> MakeBitrateZones(
     const EncoderOptionInfo& eoInfo,
     VideoInfo outvi);
 
+// 分割エンコードの1区間の最小フレーム数
+const int MIN_ENCODE_CHUNK_FRAMES = 600;
+
+// numFramesをnumChunks個の区間に分割する
+// 境界は均等に分割した位置の近くにシーンチェンジがあればそこに合わせる
+std::vector<EncoderZone> MakeEncodeChunks(int numFrames, const std::vector<int>& sceneChanges, int numChunks);
+
+// [start,end)の区間に含まれるゾーンを区間先頭からのフレーム番号にして返す
+std::vector<BitrateZone> SliceBitrateZones(const std::vector<BitrateZone>& zones, int start, int end);
+
+// マスクのCPUをnumCPUs個までに制限してnumParts個に分割する
+// マスクが0（割り当てなし）のときはnumCPUs指定があれば先頭のCPUから割り当てる
+std::vector<uint64_t> SplitAffinityMask(uint64_t mask, int numCPUs, int numParts);
+
+// 出力ファイルごとのエンコードを並列に実行する
+// 確保済みのリソースのCPUを同時実行数で分割し、
+// 各エンコードにはホストと通信しないResourceMangerで渡す
+class ParallelEncodeScheduler : AMTObject {
+public:
+    typedef std::function<void(int index, const ResourceManger& rm)> EncodeTask;
+
+    ParallelEncodeScheduler(AMTContext& ctx,
+        const ResourceAllocation& allocation, int numParallel, int numCPUs);
+
+    int getNumParallel() const;
+
+    // 全タスクの完了を待つ。タスクで例外が発生したら以降のタスクは開始せず
+    // 実行中のタスクの終了を待ってから最初の例外を投げる
+    void run(int numTasks, const EncodeTask& task);
+
+private:
+    class Worker : private ThreadBase {
+    public:
+        Worker(ParallelEncodeScheduler& parent, const ResourceAllocation& allocation);
+        ~Worker();
+    protected:
+        virtual void run();
+    private:
+        ParallelEncodeScheduler& parent;
+        ResourceManger rm;
+    };
+
+    std::vector<ResourceAllocation> slots;
+
+    std::mutex mtx;
+    const EncodeTask* task;
+    int numTasks;
+    int nextTask;
+    std::exception_ptr error;
+
+    int getNextTask();
+    void setError(std::exception_ptr e);
+};
+
+// 依存関係のあるタスクを依存先が全て完了したものから並列に実行する
+// タスクは全てstart()前に追加すること
+class TaskGraph : AMTObject {
+public:
+    typedef std::function<void()> Task;
+
+    TaskGraph(AMTContext& ctx, int numThreads);
+    ~TaskGraph();
+
+    // depsは追加済みタスクのID
+    int add(const Task& task, const std::vector<int>& deps = std::vector<int>());
+
+    // 呼び出し側で実行するタスク。完了はcomplete()で通知する
+    int addExternal();
+
+    void start();
+
+    void complete(int id);
+
+    // 実行していないタスクを捨てる
+    void cancel();
+
+    // 全タスクの完了を待つ。タスクで例外が発生していたら最初の例外を投げる
+    void wait();
+
+    // タスクで例外が発生していたら最初の例外を投げる（完了は待たない）
+    void checkError();
+
+private:
+    struct Node {
+        Task task;
+        std::vector<int> deps;
+        bool external;
+        bool started;
+        bool done;
+    };
+
+    class Worker : private ThreadBase {
+    public:
+        Worker(TaskGraph& parent);
+        ~Worker();
+    protected:
+        virtual void run();
+    private:
+        TaskGraph& parent;
+    };
+
+    int numThreads;
+    std::vector<Node> nodes;
+    int numPending;
+
+    std::mutex mtx;
+    std::condition_variable cond;
+    bool canceled;
+    std::exception_ptr error;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    int takeTask();
+    void setError(std::exception_ptr e);
+};
+
 #if 0
 // ページヒープが機能しているかテスト
 void DoBadThing();
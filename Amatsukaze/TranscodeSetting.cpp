@@ -743,6 +743,22 @@ int ConfigWrapper::getNumEncodeBufferFrames() const {
     return conf.numEncodeBufferFrames;
 }
 
+int ConfigWrapper::getNumParallelEncodes() const {
+    return std::max(1, conf.numParallelEncodes);
+}
+
+int ConfigWrapper::getNumEncodeCPUs() const {
+    return conf.numEncodeCPUs;
+}
+
+bool ConfigWrapper::isOverlapStages() const {
+    return conf.overlapStages;
+}
+
+int ConfigWrapper::getNumEncodeChunks() const {
+    return conf.numEncodeChunks;
+}
+
 const std::vector<tstring>& ConfigWrapper::getLogoPath() const {
     return conf.logoPath;
 }
@@ -783,6 +799,26 @@ bool ConfigWrapper::isParallelLogoAnalysis() const {
     return conf.parallelLogoAnalysis;
 }
 
+bool ConfigWrapper::isParallelTsAnalysis() const {
+    return conf.parallelTsAnalysis;
+}
+
+bool ConfigWrapper::isMmapInput() const {
+    return conf.mmapInput;
+}
+
+bool ConfigWrapper::isLazyWave() const {
+    return conf.lazyWave;
+}
+
+int ConfigWrapper::getNumSourceDecoders() const {
+    return std::max(1, conf.numSourceDecoders);
+}
+
+int ConfigWrapper::getSourceCacheSizeMB() const {
+    return std::max(1, conf.sourceCacheSizeMB);
+}
+
 int ConfigWrapper::getMaxFadeLength() const {
     return conf.maxFadeLength;
 }
@@ -795,6 +831,10 @@ tstring ConfigWrapper::getChapterExeOptions() const {
     return conf.chapterExeOptions;
 }
 
+bool ConfigWrapper::isChapterExeBuiltin() const {
+    return conf.chapterExeBuiltin;
+}
+
 tstring ConfigWrapper::getJoinLogoScpPath() const {
     return conf.joinLogoScpPath;
 }
@@ -876,6 +916,11 @@ tstring ConfigWrapper::getEncVideoFilePath(EncodeFileKey key) const {
         tmpDir.path().c_str(), key.video, key.format, key.div, GetCMSuffix(key.cm)));
 }
 
+tstring ConfigWrapper::getEncVideoChunkFilePath(EncodeFileKey key, int chunk) const {
+    return regtmp(StringFormat(_T("%s/v%d-%d-%d%s-c%d.raw"),
+        tmpDir.path().c_str(), key.video, key.format, key.div, GetCMSuffix(key.cm), chunk));
+}
+
 tstring ConfigWrapper::getEncVideoOptionFilePath(EncodeFileKey key) const {
     return regtmp(StringFormat(_T("%s/v%d-%d-%d%s.opt.txt"),
         tmpDir.path().c_str(), key.video, key.format, key.div, GetCMSuffix(key.cm)));
@@ -940,6 +985,10 @@ tstring ConfigWrapper::getTmpAMTSourcePath(int vindex) const {
     return regtmp(StringFormat(_T("%s/amts%d.dat"), tmpDir.path().c_str(), vindex));
 }
 
+tstring ConfigWrapper::getTmpAMTSeekIndexPath(int vindex) const {
+    return regtmp(StringFormat(_T("%s/amts%d.idx"), tmpDir.path().c_str(), vindex));
+}
+
 tstring ConfigWrapper::getTmpSourceAVSPath(int vindex) const {
     return regtmp(StringFormat(_T("%s/amts%d.avs"), tmpDir.path().c_str(), vindex));
 }
@@ -1254,6 +1303,24 @@ void ConfigWrapper::dump() const {
     }
     ctx.infoF("ロゴ消し: %s", conf.noDelogo ? "しない" : "する");
     ctx.infoF("並列ロゴ解析: %s", conf.parallelLogoAnalysis ? "オン" : "オフ");
+    if (conf.chapter) {
+        ctx.infoF("無音・シーンチェンジ解析: %s", conf.chapterExeBuiltin ? "内蔵" : "chapter_exe");
+    }
+    ctx.infoF("並列TS解析: %s", conf.parallelTsAnalysis ? "オン" : "オフ");
+    if (conf.numParallelEncodes > 1) {
+        ctx.infoF("並列エンコード: %d (CPU数: %s)", conf.numParallelEncodes,
+            (conf.numEncodeCPUs > 0) ? StringFormat("%d", conf.numEncodeCPUs) : std::string("制限なし"));
+    }
+    ctx.infoF("音声・字幕・Muxの並行実行: %s", conf.overlapStages ? "オン" : "オフ");
+    if (conf.numEncodeChunks > 1) {
+        ctx.infoF("分割エンコード: %d分割", conf.numEncodeChunks);
+    }
+    ctx.infoF("メモリマップ入力: %s", conf.mmapInput ? "オン" : "オフ");
+    ctx.infoF("解析用音声(wave): %s", conf.lazyWave ? "必要な時にデコード" : "事前にデコード");
+    if (conf.numSourceDecoders > 1) {
+        ctx.infoF("映像の並列デコード: %dデコーダ", conf.numSourceDecoders);
+    }
+    ctx.infoF("映像のフレームキャッシュ: %dMB", getSourceCacheSizeMB());
     if (conf.audioEncoder != AUDIO_ENCODER_NONE) {
         ctx.infoF("音声: %s (%s)", conf.audioEncoderPath, audioEncoderToString(conf.audioEncoder));
         if (conf.audioBitrateInKbps > 0) {
@@ -215,6 +215,10 @@ struct Config {
     DecoderSetting decoderSetting;
     int audioBitrateInKbps;
     int numEncodeBufferFrames;
+    int numParallelEncodes;
+    int numEncodeCPUs;
+    bool overlapStages;
+    int numEncodeChunks;
     // CM͗pݒ
     std::vector<tstring> logoPath;
     std::vector<tstring> eraseLogoPath;
@@ -225,9 +229,15 @@ struct Config {
     bool looseLogoDetection;
     bool noDelogo;
     bool parallelLogoAnalysis;
+    bool parallelTsAnalysis;
+    bool mmapInput;
+    bool lazyWave;
+    int numSourceDecoders;
+    int sourceCacheSizeMB;
     int maxFadeLength;
     tstring chapterExePath;
     tstring chapterExeOptions;
+    bool chapterExeBuiltin;
     tstring joinLogoScpPath;
     tstring joinLogoScpCmdPath;
     tstring joinLogoScpOptions;
@@ -336,6 +346,14 @@ public:
 
     int getNumEncodeBufferFrames() const;
 
+    int getNumParallelEncodes() const;
+
+    int getNumEncodeCPUs() const;
+
+    bool isOverlapStages() const;
+
+    int getNumEncodeChunks() const;
+
     const std::vector<tstring>& getLogoPath() const;
 
     const std::vector<tstring>& getEraseLogoPath() const;
@@ -356,12 +374,24 @@ public:
 
     bool isParallelLogoAnalysis() const;
 
+    bool isParallelTsAnalysis() const;
+
+    bool isMmapInput() const;
+
+    bool isLazyWave() const;
+
+    int getNumSourceDecoders() const;
+
+    int getSourceCacheSizeMB() const;
+
     int getMaxFadeLength() const;
 
     tstring getChapterExePath() const;
 
     tstring getChapterExeOptions() const;
 
+    bool isChapterExeBuiltin() const;
+
     tstring getJoinLogoScpPath() const;
 
     tstring getJoinLogoScpCmdPath() const;
@@ -402,6 +432,8 @@ public:
 
     tstring getEncVideoFilePath(EncodeFileKey key) const;
 
+    tstring getEncVideoChunkFilePath(EncodeFileKey key, int chunk) const;
+
     tstring getEncVideoOptionFilePath(EncodeFileKey key) const;
 
     tstring getAfsTimecodePath(EncodeFileKey key) const;
@@ -424,6 +456,8 @@ public:
 
     tstring getTmpAMTSourcePath(int vindex) const;
 
+    tstring getTmpAMTSeekIndexPath(int vindex) const;
+
     tstring getTmpSourceAVSPath(int vindex) const;
 
     tstring getTmpLogoFramePath(int vindex, int logoIndex = -1) const;
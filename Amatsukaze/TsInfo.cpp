@@ -463,20 +463,19 @@ std::vector<int> TsInfo::getSetPids() const {
 
 int TsInfo::ReadTS(File& srcfile) {
     enum {
-        BUFSIZE = 4 * 1024 * 1024,
         MAX_BYTES = 100 * 1024 * 1024
     };
-    auto buffer_ptr = std::unique_ptr<uint8_t[]>(new uint8_t[BUFSIZE]);
-    MemoryChunk buffer(buffer_ptr.get(), BUFSIZE);
+    // 途中で打ち切るのでMAX_BYTESを超えて先読みしないよう先読みは1ブロックだけにする
+    AsyncFileReader reader(srcfile, 4 * 1024 * 1024, 1);
     size_t totalRead = 0;
-    size_t readBytes;
+    MemoryChunk buffer;
     SpTsPacketParser packetParser(*this);
     do {
-        readBytes = srcfile.read(buffer);
-        packetParser.inputTS(MemoryChunk(buffer.data, readBytes));
+        buffer = reader.read();
+        packetParser.inputTS(buffer);
         if (parser.isOK()) return 0;
-        totalRead += readBytes;
-    } while (readBytes == buffer.length && totalRead < MAX_BYTES);
+        totalRead += buffer.length;
+    } while (buffer.length == reader.getBlockSize() && totalRead < MAX_BYTES);
     if (parser.isProgramOK()) return 0;
     if (parser.isScrampbled()) return 2;
     return 1;
@@ -519,18 +518,14 @@ bool TsSlimFilter::exec(const tchar* srcpath, const tchar* dstpath, TS_SLIM_CALL
         File dstfile(std::string(dstpath), "wb");
         pfile = &dstfile;
         videoOk = false;
-        enum {
-            BUFSIZE = 4 * 1024 * 1024
-        };
-        auto buffer_ptr = std::unique_ptr<uint8_t[]>(new uint8_t[BUFSIZE]);
-        MemoryChunk buffer(buffer_ptr.get(), BUFSIZE);
-        size_t readBytes;
+        AsyncFileReader reader(srcfile);
+        MemoryChunk buffer;
         SpTsPacketParser packetParser(*this);
         do {
-            readBytes = srcfile.read(buffer);
-            packetParser.inputTS(MemoryChunk(buffer.data, readBytes));
+            buffer = reader.read();
+            packetParser.inputTS(buffer);
             if (cb() == false) return false;
-        } while (readBytes == buffer.length);
+        } while (buffer.length == reader.getBlockSize());
         packetParser.flush();
         return true;
     } catch (const Exception& exception) {
@@ -10,6 +10,7 @@
 #include "Mpeg2TsParser.h"
 #include "AribString.hpp"
 #include "TsSplitter.h"
+#include "AsyncFileReader.h"
 
 #include <stdint.h>
 
@@ -173,7 +173,9 @@ TsPacketBuffer::TsPacketBuffer(AMTContext& ctx)
     , handler(NULL)
     , numBefferedPackets_(0)
     , numMaxPackets(0)
-    , buffering(false) {}
+    , buffering(false)
+    , pidFilter(NULL)
+    , numFilteredPackets_(0) {}
 
 void TsPacketBuffer::setHandler(TsPacketHandler* handler) {
     this->handler = handler;
@@ -210,6 +212,17 @@ void TsPacketBuffer::backAndInput() {
     }
 }
 
+void TsPacketBuffer::setPidFilter(const PidBitmap* filter) {
+    pidFilter = filter;
+    numFilteredPackets_ = 0;
+}
+
+int TsPacketBuffer::takeNumFilteredPackets() {
+    int ret = numFilteredPackets_;
+    numFilteredPackets_ = 0;
+    return ret;
+}
+
 /* virtual */ void TsPacketBuffer::onTsPacket(TsPacket packet) {
     if (buffering) {
         if (numBefferedPackets_ >= numMaxPackets) {
@@ -218,6 +231,10 @@ void TsPacketBuffer::backAndInput() {
         }
         buffer.add(MemoryChunk(packet.data, TS_PACKET_LENGTH));
         ++numBefferedPackets_;
+    } else if (pidFilter != NULL && !pidFilter->test(packet.PID())) {
+        // 他サービスやEIT等、使わないPIDはハンドラに渡さない
+        ++numFilteredPackets_;
+        return;
     }
     if (handler != NULL) {
         handler->onTsPacket(-1, packet);
@@ -284,6 +301,11 @@ void TsSystemClock::inputTsPacket(TsPacket packet) {
     ++numTotakPacketsReveived;
 }
 
+// PCR PID以外のパケットを数だけ入力
+void TsSystemClock::skipPackets(int numPackets) {
+    numTotakPacketsReveived += numPackets;
+}
+
 double TsSystemClock::currentBitrate() {
     int clockDiff = int(pcrInfo[1].clock - pcrInfo[0].clock);
     int indexDiff = int(pcrInfo[1].packetIndex - pcrInfo[0].packetIndex);
@@ -303,7 +325,9 @@ TsSplitter::TsSplitter(AMTContext& ctx, bool enableVideo, bool enableAudio, bool
     , enableAudio(enableAudio)
     , enableCaption(enableCaption)
     , numTotalPackets(0)
-    , numScramblePackets(0) {
+    , numScramblePackets(0)
+    , parallelFailed(false)
+    , audioOnlyParallel(false) {
     tsPacketParser.setHandler(&tsPacketHandler);
     tsPacketParser.setNumBufferingPackets(50 * 1024); // 9.6MB
     tsPacketSelector.setHandler(this);
@@ -315,6 +339,7 @@ void TsSplitter::reset() {
     preferedServiceId = -1;
     selectedServiceId = -1;
     tsPacketParser.setEnableBuffering(true);
+    tsPacketParser.setPidFilter(NULL);
 }
 
 // 0以下で指定無効
@@ -327,10 +352,89 @@ int TsSplitter::getActualServiceId() {
 }
 
 void TsSplitter::inputTsData(MemoryChunk data) {
-    tsPacketParser.inputTS(data);
+    if (demuxThread != nullptr) {
+        demuxThread->put(std::vector<uint8_t>(data.data, data.data + data.length), data.length);
+    } else {
+        tsPacketParser.inputTS(data);
+    }
 }
 void TsSplitter::flush() {
-    tsPacketParser.flush();
+    if (demuxThread != nullptr) {
+        // 空データはflush
+        demuxThread->put(std::vector<uint8_t>(), 1);
+    } else {
+        tsPacketParser.flush();
+    }
+}
+
+void TsSplitter::startParallel(bool audioOnly) {
+    if (isParallel()) {
+        THROW(InvalidOperationException, "parallel analysis already started");
+    }
+    parallelFailed = false;
+    for (int i = 0; i < (int)audioParsers.size(); ++i) {
+        audioWorkers.emplace_back(new ParseWorker(*this));
+        audioWorkers.back()->start();
+    }
+    if (audioOnly) {
+        // 映像・字幕は呼び出しスレッドでパースして反映する
+        // 音声の反映も反映スレッドは使わず呼び出しスレッドで入力順に行う
+        audioOnlyParallel = true;
+        return;
+    }
+    commitThread = std::unique_ptr<CommitThread>(new CommitThread(*this));
+    commitThread->start();
+    videoWorker = std::unique_ptr<ParseWorker>(new ParseWorker(*this));
+    videoWorker->start();
+    captionWorker = std::unique_ptr<ParseWorker>(new ParseWorker(*this));
+    captionWorker->start();
+    demuxThread = std::unique_ptr<DemuxThread>(new DemuxThread(*this));
+    demuxThread->start();
+}
+
+void TsSplitter::joinParallel() {
+    if (!isParallel()) {
+        return;
+    }
+    // 上流から順に終了させる
+    if (demuxThread != nullptr) {
+        demuxThread->join();
+    }
+    if (videoWorker != nullptr) {
+        videoWorker->join();
+    }
+    for (auto& worker : audioWorkers) {
+        worker->join();
+    }
+    if (captionWorker != nullptr) {
+        captionWorker->join();
+    }
+    if (commitThread != nullptr) {
+        commitThread->join();
+    }
+    demuxThread = nullptr;
+    videoWorker = nullptr;
+    audioWorkers.clear();
+    captionWorker = nullptr;
+    commitThread = nullptr;
+    // 反映されずに残ったジョブは捨てる
+    pendingJobs.clear();
+    audioOnlyParallel = false;
+}
+
+void TsSplitter::finishParallel() {
+    if (audioOnlyParallel && !parallelFailed) {
+        try {
+            commitPendingJobs(0);
+        } catch (const Exception&) {
+            joinParallel();
+            throw;
+        }
+    }
+    joinParallel();
+    if (parallelFailed) {
+        THROW(RuntimeException, "並列TS解析でエラーが発生しました");
+    }
 }
 
 int64_t TsSplitter::getNumTotalPackets() const {
@@ -340,10 +444,190 @@ int64_t TsSplitter::getNumTotalPackets() const {
 int64_t TsSplitter::getNumScramblePackets() const {
     return numScramblePackets;
 }
+
+bool TsSplitter::isParallel() const {
+    return commitThread != nullptr || audioOnlyParallel;
+}
+
+void TsSplitter::commitPendingJobs(size_t maxPending) {
+    while (pendingJobs.size() > 0) {
+        auto& job = pendingJobs.front();
+        if (pendingJobs.size() <= maxPending && !job->isDone()) {
+            break;
+        }
+        if (!job->wait()) {
+            parallelFailed = true;
+            THROW(RuntimeException, "ES parse failed");
+        }
+        // 反映中に例外が出ても同じジョブを二度反映しないように先に取り出す
+        auto commitJob = std::move(job);
+        pendingJobs.pop_front();
+        for (auto& commit : commitJob->commits) {
+            commit();
+        }
+    }
+}
+
+template <typename Parser>
+void TsSplitter::postPesPacket(ParseWorker* worker, Parser* parser, int64_t clock, PESPacket packet,
+    const ParseJobPtr& committed) {
+    auto job = std::make_shared<ParseJob>();
+    job->data.assign(packet.data, packet.data + packet.length);
+    packet.data = job->data.data();
+    job->parse = [this, parser, clock, packet, committed](ParseJob* job) {
+        if (committed != nullptr) {
+            waitCommitted(*committed);
+        }
+        parser->parsePesPacket(job, clock, packet);
+    };
+    if (worker == nullptr) {
+        // 音声のみ並列: 呼び出しスレッドでパースする
+        commitPendingJobs(MAX_PENDING_JOBS);
+        if (pendingJobs.size() == 0) {
+            // 先行する反映待ちがなければ逐次処理と同じくその場で反映する
+            parser->parsePesPacket(nullptr, clock, packet);
+            return;
+        }
+        // 反映待ちの音声があるので後ろに並べる
+        // 反映はパース結果を参照するのでデータのコピーは必要
+        job->parse(job.get());
+        job->finish(false);
+        pendingJobs.push_back(std::move(job));
+        return;
+    }
+    if (audioOnlyParallel) {
+        commitPendingJobs(MAX_PENDING_JOBS);
+        pendingJobs.push_back(job);
+        worker->put(std::move(job), 1);
+        return;
+    }
+    // 反映順を入力順にするため先に反映キューに入れる
+    commitThread->put(ParseJobPtr(job), 1);
+    worker->put(std::move(job), 1);
+}
+
+void TsSplitter::waitCommitted(ParseJob& committed) {
+    // 反映スレッドはエラー後のジョブを反映せずに捨てるので完了しないことがある
+    while (!committed.waitFor(100)) {
+        if (parallelFailed) {
+            THROW(RuntimeException, "ES parse failed");
+        }
+    }
+}
+
+void TsSplitter::runOnWorker(ParseWorker* worker, const std::function<void()>& func) {
+    if (worker == nullptr) {
+        func();
+        return;
+    }
+    auto job = std::make_shared<ParseJob>();
+    job->parse = [func](ParseJob*) { func(); };
+    worker->put(std::move(job), 1);
+}
+
+void TsSplitter::runInOrder(const std::function<void()>& func) {
+    if (audioOnlyParallel) {
+        commitPendingJobs(MAX_PENDING_JOBS);
+        if (pendingJobs.size() == 0) {
+            func();
+            return;
+        }
+    } else if (!isParallel()) {
+        func();
+        return;
+    }
+    auto job = std::make_shared<ParseJob>();
+    job->commits.push_back(func);
+    job->finish(false);
+    if (audioOnlyParallel) {
+        pendingJobs.push_back(std::move(job));
+    } else {
+        commitThread->put(std::move(job), 1);
+    }
+}
+TsSplitter::ParseJob::ParseJob()
+    : done(false), failed(false) {}
+
+void TsSplitter::ParseJob::finish(bool failed) {
+    std::unique_lock<std::mutex> lock(mtx);
+    this->failed = failed;
+    done = true;
+    cond.notify_all();
+}
+
+bool TsSplitter::ParseJob::wait() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!done) {
+        cond.wait(lock);
+    }
+    return !failed;
+}
+
+bool TsSplitter::ParseJob::waitFor(int ms) {
+    std::unique_lock<std::mutex> lock(mtx);
+    return cond.wait_for(lock, std::chrono::milliseconds(ms), [this]() { return done; });
+}
+
+bool TsSplitter::ParseJob::isDone() {
+    std::unique_lock<std::mutex> lock(mtx);
+    return done;
+}
+TsSplitter::DemuxThread::DemuxThread(TsSplitter& this_)
+    : DataPumpThread<std::vector<uint8_t>>(16 * 1024 * 1024)
+    , this_(this_) {}
+
+/* virtual */ void TsSplitter::DemuxThread::OnDataReceived(std::vector<uint8_t>&& data) {
+    try {
+        if (data.size() == 0) {
+            this_.tsPacketParser.flush();
+        } else {
+            this_.tsPacketParser.inputTS(MemoryChunk(data.data(), data.size()));
+        }
+    } catch (const Exception&) {
+        this_.parallelFailed = true;
+        throw;
+    }
+}
+TsSplitter::ParseWorker::ParseWorker(TsSplitter& this_)
+    : DataPumpThread<ParseJobPtr>(256)
+    , this_(this_)
+    , failed(false) {}
+
+/* virtual */ void TsSplitter::ParseWorker::OnDataReceived(ParseJobPtr&& job) {
+    if (!failed) {
+        try {
+            job->parse(job.get());
+        } catch (const Exception&) {
+            this_.parallelFailed = true;
+            failed = true;
+        }
+    }
+    // エラー後も完了させないと反映スレッドが止まってしまう
+    job->finish(failed);
+}
+TsSplitter::CommitThread::CommitThread(TsSplitter& this_)
+    : DataPumpThread<ParseJobPtr>(512)
+    , this_(this_) {}
+
+/* virtual */ void TsSplitter::CommitThread::OnDataReceived(ParseJobPtr&& job) {
+    if (!job->wait()) {
+        THROW(RuntimeException, "ES parse failed");
+    }
+    try {
+        for (auto& commit : job->commits) {
+            commit();
+        }
+    } catch (const Exception&) {
+        this_.parallelFailed = true;
+        throw;
+    }
+}
 TsSplitter::SpTsPacketHandler::SpTsPacketHandler(TsSplitter& this_)
     : this_(this_) {}
 
 /* virtual */ void TsSplitter::SpTsPacketHandler::onTsPacket(int64_t clock, TsPacket packet) {
+    // フィルタで除外されたパケットもクロック計算のパケット位置には含める
+    this_.tsSystemClock.skipPackets(this_.tsPacketParser.takeNumFilteredPackets());
     this_.tsSystemClock.inputTsPacket(packet);
 
     int64_t packetClock = this_.tsSystemClock.getClock(0);
@@ -369,34 +653,137 @@ TsSplitter::PcrDetectionHandler::PcrDetectionHandler(TsSplitter& this_)
         this_.tsPacketParser.backAndInput();
         // もう必要ないのでバッファリングはOFF
         this_.tsPacketParser.setEnableBuffering(false);
+        // PMTが分かったので以降は処理対象のPIDだけ通す
+        // PID Tableが変わるとTsPacketSelectorがマップを更新する
+        this_.tsPacketParser.setPidFilter(this_.tsPacketSelector.getPidMap());
     }
 }
 TsSplitter::SpVideoFrameParser::SpVideoFrameParser(AMTContext&ctx, TsSplitter& this_)
-    : VideoFrameParser(ctx), this_(this_) {}
+    : VideoFrameParser(ctx), this_(this_), job(nullptr) {}
+void TsSplitter::SpVideoFrameParser::parsePesPacket(ParseJob* job, int64_t clock, PESPacket packet) {
+    this->job = job;
+    VideoFrameParser::onPesPacket(clock, packet);
+    this->job = nullptr;
+}
+
+/* virtual */ void TsSplitter::SpVideoFrameParser::onPesPacket(int64_t clock, PESPacket packet) {
+    if (this_.isParallel()) {
+        this_.postPesPacket(this_.videoWorker.get(), this, clock, packet);
+    } else {
+        VideoFrameParser::onPesPacket(clock, packet);
+    }
+}
+
 /* virtual */ void TsSplitter::SpVideoFrameParser::onVideoPesPacket(int64_t clock, const std::vector<VideoFrameInfo>& frames, PESPacket packet) {
     if (clock == -1) {
         ctx.error("Video PES Packet にクロック情報がありません");
         return;
     }
-    this_.onVideoPesPacket(clock, frames, packet);
+    if (job != nullptr) {
+        job->commits.push_back([this, clock, frames, packet]() {
+            this_.onVideoPesPacket(clock, frames, packet);
+        });
+    } else {
+        this_.onVideoPesPacket(clock, frames, packet);
+    }
 }
 
 /* virtual */ void TsSplitter::SpVideoFrameParser::onVideoFormatChanged(VideoFormat fmt) {
-    this_.onVideoFormatChanged(fmt);
+    if (job != nullptr) {
+        job->commits.push_back([this, fmt]() { this_.onVideoFormatChanged(fmt); });
+    } else {
+        this_.onVideoFormatChanged(fmt);
+    }
 }
 TsSplitter::SpAudioFrameParser::SpAudioFrameParser(AMTContext&ctx, TsSplitter& this_, int audioIdx)
-    : AudioFrameParser(ctx), this_(this_), audioIdx(audioIdx) {}
+    : AudioFrameParser(ctx), this_(this_), audioIdx(audioIdx), job(nullptr) {}
+void TsSplitter::SpAudioFrameParser::parsePesPacket(ParseJob* job, int64_t clock, PESPacket packet) {
+    this->job = job;
+    AudioFrameParser::onPesPacket(clock, packet);
+    this->job = nullptr;
+}
+
+/* virtual */ void TsSplitter::SpAudioFrameParser::onPesPacket(int64_t clock, PESPacket packet) {
+    if (this_.isParallel()) {
+        this_.postPesPacket(this_.audioWorkers[audioIdx].get(), this, clock, packet);
+    } else {
+        AudioFrameParser::onPesPacket(clock, packet);
+    }
+}
+
 /* virtual */ void TsSplitter::SpAudioFrameParser::onAudioPesPacket(int64_t clock, const std::vector<AudioFrameData>& frames, PESPacket packet) {
-    this_.onAudioPesPacket(audioIdx, clock, frames, packet);
+    if (job != nullptr) {
+        // フレームデータはAdtsParserのバッファを指していて次のパースで無効になるのでコピーする
+        // uint16_tのアラインメントを保つためデコード済みデータを先に置く
+        size_t totalSize = 0;
+        for (const AudioFrameData& frame : frames) {
+            totalSize += frame.decodedDataSize + frame.codedDataSize;
+        }
+        auto buffer = std::make_shared<std::vector<uint8_t>>(totalSize);
+        auto copied = std::make_shared<std::vector<AudioFrameData>>(frames);
+        uint8_t* ptr = buffer->data();
+        for (AudioFrameData& frame : *copied) {
+            if (frame.decodedDataSize > 0) {
+                memcpy(ptr, frame.decodedData, frame.decodedDataSize);
+                frame.decodedData = (uint16_t*)ptr;
+                ptr += frame.decodedDataSize;
+            }
+        }
+        for (AudioFrameData& frame : *copied) {
+            memcpy(ptr, frame.codedData, frame.codedDataSize);
+            frame.codedData = ptr;
+            ptr += frame.codedDataSize;
+        }
+        job->commits.push_back([this, clock, buffer, copied, packet]() {
+            this_.onAudioPesPacket(audioIdx, clock, *copied, packet);
+        });
+    } else {
+        this_.onAudioPesPacket(audioIdx, clock, frames, packet);
+    }
 }
 
 /* virtual */ void TsSplitter::SpAudioFrameParser::onAudioFormatChanged(AudioFormat fmt) {
-    this_.onAudioFormatChanged(audioIdx, fmt);
+    if (job != nullptr) {
+        job->commits.push_back([this, fmt]() { this_.onAudioFormatChanged(audioIdx, fmt); });
+    } else {
+        this_.onAudioFormatChanged(audioIdx, fmt);
+    }
 }
 TsSplitter::SpCaptionParser::SpCaptionParser(AMTContext&ctx, TsSplitter& this_)
-    : CaptionParser(ctx), this_(this_) {}
+    : CaptionParser(ctx), this_(this_), job(nullptr) {}
+void TsSplitter::SpCaptionParser::parsePesPacket(ParseJob* job, int64_t clock, PESPacket packet) {
+    this->job = job;
+    CaptionParser::onPesPacket(clock, packet);
+    this->job = nullptr;
+}
+
+/* virtual */ void TsSplitter::SpCaptionParser::onPesPacket(int64_t clock, PESPacket packet) {
+    if (this_.audioOnlyParallel) {
+        // 字幕のパースは映像の反映結果（先頭PTS）を参照するので先行する反映を全て済ませておく
+        this_.commitPendingJobs(0);
+    } else if (this_.isParallel()) {
+        // 全て並列の場合は字幕スレッドで先行する反映が済むのを待ってからパースする
+        auto committed = std::make_shared<ParseJob>();
+        this_.runInOrder([committed]() { committed->finish(false); });
+        this_.postPesPacket(this_.captionWorker.get(), this, clock, packet, committed);
+        return;
+    }
+    if (this_.isParallel()) {
+        this_.postPesPacket(this_.captionWorker.get(), this, clock, packet);
+    } else {
+        CaptionParser::onPesPacket(clock, packet);
+    }
+}
+
 /* virtual */ void TsSplitter::SpCaptionParser::onCaptionPesPacket(int64_t clock, std::vector<CaptionItem>& captions, PESPacket packet) {
-    this_.onCaptionPesPacket(clock, captions, packet);
+    if (job != nullptr) {
+        auto items = std::make_shared<std::vector<CaptionItem>>(std::move(captions));
+        job->commits.push_back([this, clock, items, packet]() {
+            this_.onCaptionPesPacket(clock, *items, packet);
+        });
+    } else {
+        this_.onCaptionPesPacket(clock, captions, packet);
+    }
 }
 
 /* virtual */ DRCSOutInfo TsSplitter::SpCaptionParser::getDRCSOutPath(int64_t PTS, const std::string& md5) {
@@ -447,12 +834,13 @@ TsSplitter::SpCaptionParser::SpCaptionParser(AMTContext&ctx, TsSplitter& this_)
 /* virtual */ void TsSplitter::onPidTableChanged(const PMTESInfo video, const std::vector<PMTESInfo>& audio, const PMTESInfo caption) {
     if (enableVideo || enableAudio) {
         // 映像ストリーム形式をセット
+        // 並列解析時はパース中のPESと競合しないようワーカースレッドで変更する
         switch (video.stype) {
         case 0x02: // MPEG2-VIDEO
-            videoParser.setStreamFormat(VS_MPEG2);
+            runOnWorker(videoWorker.get(), [this]() { videoParser.setStreamFormat(VS_MPEG2); });
             break;
         case 0x1B: // H.264/AVC
-            videoParser.setStreamFormat(VS_H264);
+            runOnWorker(videoWorker.get(), [this]() { videoParser.setStreamFormat(VS_H264); });
             break;
         }
 
@@ -461,6 +849,10 @@ TsSplitter::SpCaptionParser::SpCaptionParser(AMTContext&ctx, TsSplitter& this_)
         while (audioParsers.size() < numAudios) {
             int audioIdx = int(audioParsers.size());
             audioParsers.push_back(new SpAudioFrameParser(ctx, *this, audioIdx));
+            if (isParallel()) {
+                audioWorkers.emplace_back(new ParseWorker(*this));
+                audioWorkers.back()->start();
+            }
             ctx.infoF("音声パーサ %d を追加", audioIdx);
         }
     }
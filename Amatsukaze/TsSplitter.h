@@ -15,8 +15,13 @@
 #include <vector>
 #include <map>
 #include <array>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <deque>
 
 #include "StreamUtils.h"
+#include "ProcessThread.h"
 #include "Mpeg2TsParser.h"
 #include "Mpeg2VideoParser.h"
 #include "H264VideoParser.h"
@@ -115,6 +120,13 @@ public:
 
     void backAndInput();
 
+    // filterにないPIDのパケットはハンドラに渡さない（NULLで無効）
+    // バッファリング中は無効
+    void setPidFilter(const PidBitmap* filter);
+
+    // 前回呼び出し以降にフィルタで除外されたパケット数
+    int takeNumFilteredPackets();
+
     virtual void onTsPacket(TsPacket packet);
 
 private:
@@ -123,6 +135,8 @@ private:
     int numBefferedPackets_;
     int numMaxPackets;
     bool buffering;
+    const PidBitmap* pidFilter;
+    int numFilteredPackets_;
 };
 
 class TsSystemClock {
@@ -143,6 +157,9 @@ public:
     // TSストリームの全データを入れること
     void inputTsPacket(TsPacket packet);
 
+    // PCR PID以外のパケットを数だけ入力
+    void skipPackets(int numPackets);
+
     double currentBitrate();
 
 private:
@@ -171,6 +188,17 @@ public:
     void inputTsData(MemoryChunk data);
     void flush();
 
+    // 並列解析を開始
+    // 以降のinputTsDataは解析スレッドで処理され、ESのパースはES毎のワーカースレッドで行われる
+    // 結果の通知（onVideoPesPacket等）は解析スレッドから入力順に行われるので逐次処理と同じになる
+    // audioOnly=trueの場合は音声（AACデコード）だけを音声ストリーム毎のワーカースレッドで行い、
+    // TS分離と映像・字幕のパース・結果の通知は呼び出しスレッドで行う（音声の通知も呼び出しスレッドから入力順）
+    void startParallel(bool audioOnly = false);
+    // 入力済みデータの処理を全て終えてスレッドを終了する（例外は投げない）
+    void joinParallel();
+    // joinParallelしてスレッドでエラーがあった場合は例外を投げる
+    void finishParallel();
+
     int64_t getNumTotalPackets() const;
 
     int64_t getNumScramblePackets() const;
@@ -196,12 +224,64 @@ protected:
 
         virtual void onTsPacket(int64_t clock, TsPacket packet);
     };
+    // 並列解析時のESパース単位
+    struct ParseJob {
+        ParseJob();
+        // PESパケットのコピー
+        std::vector<uint8_t> data;
+        // ワーカースレッドで実行
+        std::function<void(ParseJob* job)> parse;
+        // パース結果の反映 解析スレッドで入力順に実行される
+        std::vector<std::function<void()>> commits;
+
+        void finish(bool failed);
+        // 終了を待つ 失敗していたらfalse
+        bool wait();
+        // 最大msミリ秒終了を待つ 終了していたらtrue
+        bool waitFor(int ms);
+        bool isDone();
+    private:
+        std::mutex mtx;
+        std::condition_variable cond;
+        bool done;
+        bool failed;
+    };
+    typedef std::shared_ptr<ParseJob> ParseJobPtr;
+
+    class DemuxThread : public DataPumpThread<std::vector<uint8_t>> {
+        TsSplitter& this_;
+    public:
+        DemuxThread(TsSplitter& this_);
+    protected:
+        virtual void OnDataReceived(std::vector<uint8_t>&& data);
+    };
+    class ParseWorker : public DataPumpThread<ParseJobPtr> {
+        TsSplitter& this_;
+        bool failed;
+    public:
+        ParseWorker(TsSplitter& this_);
+    protected:
+        virtual void OnDataReceived(ParseJobPtr&& job);
+    };
+    class CommitThread : public DataPumpThread<ParseJobPtr> {
+        TsSplitter& this_;
+    public:
+        CommitThread(TsSplitter& this_);
+    protected:
+        virtual void OnDataReceived(ParseJobPtr&& job);
+    };
+
     class SpVideoFrameParser : public VideoFrameParser {
         TsSplitter& this_;
+        ParseJob* job;
     public:
         SpVideoFrameParser(AMTContext&ctx, TsSplitter& this_);
 
+        void parsePesPacket(ParseJob* job, int64_t clock, PESPacket packet);
+
     protected:
+        virtual void onPesPacket(int64_t clock, PESPacket packet);
+
         virtual void onVideoPesPacket(int64_t clock, const std::vector<VideoFrameInfo>& frames, PESPacket packet);
 
         virtual void onVideoFormatChanged(VideoFormat fmt);
@@ -209,9 +289,14 @@ protected:
     class SpAudioFrameParser : public AudioFrameParser {
         TsSplitter& this_;
         int audioIdx;
+        ParseJob* job;
     public:
         SpAudioFrameParser(AMTContext&ctx, TsSplitter& this_, int audioIdx);
 
+        void parsePesPacket(ParseJob* job, int64_t clock, PESPacket packet);
+
+        virtual void onPesPacket(int64_t clock, PESPacket packet);
+
     protected:
         virtual void onAudioPesPacket(int64_t clock, const std::vector<AudioFrameData>& frames, PESPacket packet);
 
@@ -219,9 +304,14 @@ protected:
     };
     class SpCaptionParser : public CaptionParser {
         TsSplitter& this_;
+        ParseJob* job;
     public:
         SpCaptionParser(AMTContext&ctx, TsSplitter& this_);
 
+        void parsePesPacket(ParseJob* job, int64_t clock, PESPacket packet);
+
+        virtual void onPesPacket(int64_t clock, PESPacket packet);
+
     protected:
         virtual void onCaptionPesPacket(int64_t clock, std::vector<CaptionItem>& captions, PESPacket packet);
 
@@ -249,6 +339,39 @@ protected:
     int64_t numTotalPackets;
     int64_t numScramblePackets;
 
+    // 並列解析用
+    std::unique_ptr<DemuxThread> demuxThread;
+    std::unique_ptr<ParseWorker> videoWorker;
+    std::vector<std::unique_ptr<ParseWorker>> audioWorkers;
+    std::unique_ptr<ParseWorker> captionWorker;
+    std::unique_ptr<CommitThread> commitThread;
+    std::atomic<bool> parallelFailed;
+    // 音声のみ並列の場合の反映待ちジョブ（呼び出しスレッドで入力順に反映する）
+    enum { MAX_PENDING_JOBS = 512 };
+    bool audioOnlyParallel;
+    std::deque<ParseJobPtr> pendingJobs;
+
+    bool isParallel() const;
+
+    // PESパケットをコピーしてワーカースレッドでパースする（workerがNULLなら呼び出しスレッドでパース）
+    // committedを指定するとワーカースレッドでそれが反映されるのを待ってからパースする
+    template <typename Parser>
+    void postPesPacket(ParseWorker* worker, Parser* parser, int64_t clock, PESPacket packet,
+        const ParseJobPtr& committed = ParseJobPtr());
+
+    // runInOrderで反映されるcommittedの完了を待つ（反映スレッドがエラーで止まったら例外）
+    void waitCommitted(ParseJob& committed);
+
+    // 音声のみ並列の場合に反映待ちジョブを先頭から反映する
+    // 完了済みのものは全て反映し、maxPendingを超えている間は完了を待つ
+    void commitPendingJobs(size_t maxPending);
+
+    // パーサの状態を変更する処理をワーカースレッドで実行する（逐次処理時はすぐ実行）
+    void runOnWorker(ParseWorker* worker, const std::function<void()>& func);
+
+    // 解析結果に影響する処理をPESパケットの結果と同じ順序で実行する（逐次処理時はすぐ実行）
+    void runInOrder(const std::function<void()>& func);
+
     virtual void onVideoPesPacket(
         int64_t clock,
         const std::vector<VideoFrameInfo>& frames,
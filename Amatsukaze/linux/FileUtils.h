@@ -109,6 +109,9 @@ public:
     int64_t pos() const {
         return ftello64(fp_);
     }
+    int fd() const {
+        return fileno(fp_);
+    }
     int64_t size() const {
         int64_t cur = ftello64(fp_);
         if (cur < 0) {
@@ -10,6 +10,8 @@
 #include "rgy_thread_affinity.h"
 
 #include <sys/wait.h>
+#include <sys/uio.h>
+#include <limits.h>
 
 std::vector<std::string> split(const std::string& src, const char* delim = " ") {
     std::vector<std::string> vec;
@@ -116,6 +118,34 @@ void SubProcess::write(MemoryChunk mc) {
         THROW(RuntimeException, "failed to write to stdin pipe (bytes written mismatch)");
     }
 }
+void SubProcess::write(const std::vector<MemoryChunk>& chunks) {
+    // バッファをコピーせずwritevでまとめて書き込む
+    std::vector<struct iovec> iov;
+    iov.reserve(chunks.size());
+    for (const auto& mc : chunks) {
+        if (mc.length > 0) {
+            iov.push_back({ mc.data, mc.length });
+        }
+    }
+    size_t pos = 0;
+    while (pos < iov.size()) {
+        int cnt = (int)std::min<size_t>(iov.size() - pos, IOV_MAX);
+        ssize_t ret = writev(stdInPipe_.fd_[WRITE_HANDLE], &iov[pos], cnt);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            THROWF(RuntimeException, "failed to write to stdin pipe: %s", strerror(errno));
+        }
+        // 書き込めなかった分から再開
+        size_t written = (size_t)ret;
+        while (pos < iov.size() && written >= iov[pos].iov_len) {
+            written -= iov[pos++].iov_len;
+        }
+        if (written > 0) {
+            iov[pos].iov_base = (uint8_t*)iov[pos].iov_base + written;
+            iov[pos].iov_len -= written;
+        }
+    }
+}
 size_t SubProcess::readErr(MemoryChunk mc) {
     return readGeneric(mc, stdErrPipe_.fd_[READ_HANDLE]);
 }
@@ -13,9 +13,13 @@
 #include <string>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <vector>
+#include <algorithm>
 #include <condition_variable>
 #include <unistd.h>
 #include <pthread.h>
+#include <immintrin.h>
 
 #include "StreamUtils.h"
 #include "../PerformanceUtil.h"
@@ -81,14 +85,29 @@ private:
     }
 };
 
+// 単一プロデューサ・単一コンシューマのリングバッファでデータを渡す
+// put()は1つのスレッドからのみ呼び出すこと
+// 待ちは少しスピンしてからmutexで待つ
 template <typename T, bool PERF = false>
 class DataPumpThread : private ThreadBase {
+    enum { SPIN_COUNT = 256, MAX_SLOTS = 4096 };
 public:
     DataPumpThread(size_t maximum)
         : maximum_(maximum)
+        , mask_(0)
+        , head_(0)
+        , tail_(0)
         , current_(0)
         , finished_(false)
-        , error_(false) {}
+        , error_(false)
+        , producerWaiting_(false)
+        , consumerWaiting_(false) {
+        // amountの合計がmaximumに達する前にスロットが尽きないようにする
+        size_t numSlots = 2;
+        while (numSlots < std::min<size_t>(maximum + 1, MAX_SLOTS)) numSlots <<= 1;
+        slots_.resize(numSlots);
+        mask_ = numSlots - 1;
+    }
 
     ~DataPumpThread() {
         if (isRunning()) {
@@ -97,23 +116,26 @@ public:
     }
 
     void put(T&& data, size_t amount) {
-        std::unique_lock<std::mutex> lock(critical_section_);
-        if (error_) {
+        if (error_.load(std::memory_order_acquire)) {
             THROW(RuntimeException, "DataPumpThread error");
         }
-        if (finished_) {
+        if (finished_.load(std::memory_order_relaxed)) {
             THROW(InvalidOperationException, "DataPumpThread is already finished");
         }
-        while (current_ >= maximum_) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (!canPut(tail)) {
             if (PERF) producer.start();
-            cond_full_.wait(lock);
+            waitProducer(tail);
             if (PERF) producer.stop();
         }
-        if (data_.size() == 0) {
+        slots_[tail & mask_].first = amount;
+        slots_[tail & mask_].second = std::move(data);
+        current_.fetch_add(amount, std::memory_order_relaxed);
+        tail_.store(tail + 1, std::memory_order_seq_cst);
+        if (consumerWaiting_.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> lock(critical_section_);
             cond_empty_.notify_one();
         }
-        data_.emplace_back(amount, std::move(data));
-        current_ += amount;
     }
 
     void start() {
@@ -125,8 +147,8 @@ public:
 
     void join() {
         {
-            std::unique_lock<std::mutex> lock(critical_section_);
-            finished_ = true;
+            std::lock_guard<std::mutex> lock(critical_section_);
+            finished_.store(true, std::memory_order_seq_cst);
             cond_empty_.notify_one();
         }
         ThreadBase::join();
@@ -147,43 +169,90 @@ private:
     std::condition_variable cond_full_;
     std::condition_variable cond_empty_;
 
-    std::deque<std::pair<size_t, T>> data_;
+    std::vector<std::pair<size_t, T>> slots_;
 
     size_t maximum_;
-    size_t current_;
+    size_t mask_;
 
-    bool finished_;
-    bool error_;
+    // headはコンシューマ、tailはプロデューサだけが更新する
+    std::atomic<size_t> head_;
+    std::atomic<size_t> tail_;
+    std::atomic<size_t> current_;
+
+    std::atomic<bool> finished_;
+    std::atomic<bool> error_;
+    std::atomic<bool> producerWaiting_;
+    std::atomic<bool> consumerWaiting_;
 
     Stopwatch producer;
     Stopwatch consumer;
 
+    bool canPut(size_t tail) {
+        return (tail - head_.load(std::memory_order_seq_cst) <= mask_) &&
+            (current_.load(std::memory_order_seq_cst) < maximum_);
+    }
+
+    void waitProducer(size_t tail) {
+        for (int i = 0; i < SPIN_COUNT; ++i) {
+            if (canPut(tail)) return;
+            _mm_pause();
+        }
+        std::unique_lock<std::mutex> lock(critical_section_);
+        producerWaiting_.store(true, std::memory_order_seq_cst);
+        while (!canPut(tail)) {
+            cond_full_.wait(lock);
+        }
+        producerWaiting_.store(false, std::memory_order_relaxed);
+    }
+
+    // データが来たらtrue、終了ならfalse
+    bool waitConsumer(size_t head) {
+        for (int i = 0; i < SPIN_COUNT; ++i) {
+            if (tail_.load(std::memory_order_acquire) != head) return true;
+            _mm_pause();
+        }
+        std::unique_lock<std::mutex> lock(critical_section_);
+        consumerWaiting_.store(true, std::memory_order_seq_cst);
+        while (tail_.load(std::memory_order_seq_cst) == head) {
+            // 空でfinished_なら終了
+            if (finished_.load(std::memory_order_seq_cst) || error_.load()) {
+                consumerWaiting_.store(false, std::memory_order_relaxed);
+                return false;
+            }
+            cond_empty_.wait(lock);
+        }
+        consumerWaiting_.store(false, std::memory_order_relaxed);
+        return true;
+    }
+
     virtual void run() {
+        size_t head = head_.load(std::memory_order_relaxed);
         while (true) {
-            T data;
-            {
-                std::unique_lock<std::mutex> lock(critical_section_);
-                while (data_.size() == 0) {
-                    // data_.size()==0��finished_�Ȃ�I��
-                    if (finished_ || error_) return;
-                    if (PERF) consumer.start();
-                    cond_empty_.wait(lock);
-                    if (PERF) consumer.stop();
-                }
-                auto& entry = data_.front();
-                size_t newsize = current_ - entry.first;
-                if ((current_ >= maximum_) && (newsize < maximum_)) {
-                    cond_full_.notify_all();
-                }
-                current_ = newsize;
-                data = std::move(entry.second);
-                data_.pop_front();
+            size_t tail = tail_.load(std::memory_order_acquire);
+            if (tail == head) {
+                if (PERF) consumer.start();
+                bool hasData = waitConsumer(head);
+                if (PERF) consumer.stop();
+                if (!hasData) return;
+                tail = tail_.load(std::memory_order_acquire);
             }
-            if (error_ == false) {
-                try {
-                    OnDataReceived(std::move(data));
-                } catch (Exception&) {
-                    error_ = true;
+            // 溜まっている分をまとめて処理する
+            for (; head != tail; ++head) {
+                auto& slot = slots_[head & mask_];
+                T data = std::move(slot.second);
+                slot.second = T();
+                current_.fetch_sub(slot.first, std::memory_order_relaxed);
+                head_.store(head + 1, std::memory_order_seq_cst);
+                if (producerWaiting_.load(std::memory_order_seq_cst)) {
+                    std::lock_guard<std::mutex> lock(critical_section_);
+                    cond_full_.notify_one();
+                }
+                if (error_.load(std::memory_order_relaxed) == false) {
+                    try {
+                        OnDataReceived(std::move(data));
+                    } catch (Exception&) {
+                        error_.store(true, std::memory_order_release);
+                    }
                 }
             }
         }
@@ -198,6 +267,8 @@ public:
     SubProcess(const tstring& args, const bool disablePowerThrottoling = false);
     ~SubProcess();
     void write(MemoryChunk mc);
+    // 複数のバッファをまとめて書き込む
+    void write(const std::vector<MemoryChunk>& chunks);
     size_t readErr(MemoryChunk mc);
     size_t readOut(MemoryChunk mc);
     void finishWrite();
@@ -67,6 +67,42 @@ void SubProcess::write(MemoryChunk mc) {
         THROW(RuntimeException, "failed to write to stdin pipe (bytes written mismatch)");
     }
 }
+void SubProcess::write(const std::vector<MemoryChunk>& chunks) {
+    enum {
+        // ȉ̃obt@Ȃ炻̂܂܏
+        DIRECT_WRITE_CHUNKS = 4,
+        // ȏ̃obt@̓Rs[ɂ̂܂܏
+        DIRECT_WRITE_SIZE = 256 * 1024,
+        STAGING_SIZE = 1024 * 1024,
+    };
+    if (chunks.size() <= DIRECT_WRITE_CHUNKS) {
+        for (const auto& mc : chunks) {
+            write(mc);
+        }
+        return;
+    }
+    // sƂ̃obt@Ȃǂ͂܂Ƃ߂Ă珑
+    writeBuffer_.reserve(STAGING_SIZE);
+    writeBuffer_.clear();
+    auto flush = [&]() {
+        if (writeBuffer_.size() > 0) {
+            write(MemoryChunk(writeBuffer_.data(), writeBuffer_.size()));
+            writeBuffer_.clear();
+        }
+    };
+    for (const auto& mc : chunks) {
+        if (mc.length >= DIRECT_WRITE_SIZE) {
+            flush();
+            write(mc);
+            continue;
+        }
+        if (writeBuffer_.size() + mc.length > STAGING_SIZE) {
+            flush();
+        }
+        writeBuffer_.insert(writeBuffer_.end(), mc.data, mc.data + mc.length);
+    }
+    flush();
+}
 size_t SubProcess::readErr(MemoryChunk mc) {
     return readGeneric(mc, stdErrPipe_.readHandle);
 }
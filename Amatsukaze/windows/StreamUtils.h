@@ -10,8 +10,10 @@
 #include <algorithm>
 #include <vector>
 #include <array>
+#include <atomic>
 #include <map>
 #include <set>
+#include <mutex>
 #include <fstream>
 
 #include "CoreUtils.hpp"
@@ -383,10 +385,12 @@ public:
     }
 
     void registerTmpFile(const tstring& path) {
+        std::lock_guard<std::mutex> lock(tmpFilesMtx);
         tmpFiles.insert(path);
     }
 
     void clearTmpFiles() {
+        std::lock_guard<std::mutex> lock(tmpFilesMtx);
         for (auto& path : tmpFiles) {
             if (path.find(_T('*')) != tstring::npos) {
                 auto dir = pathGetDirectory(path);
@@ -467,7 +471,8 @@ private:
     int acp;
 
     std::set<tstring> tmpFiles;
-    std::array<int, AMT_ERR_MAX> errCounter;
+    std::mutex tmpFilesMtx;
+    std::array<std::atomic<int>, AMT_ERR_MAX> errCounter;
     std::string errMessage;
 
     std::map<std::string, std::wstring> drcsMap;